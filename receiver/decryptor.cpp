@@ -1,22 +1,38 @@
 #include "decryptor.h"
 #include "utils.h"
-#include "../shared/include/huffman.h"
+#include "../shared/include/codec.h"
 #include "../shared/include/aes_cbc.h"
+#include "../shared/include/seekable.h"
 #include "../shared/include/rsa_utils.h"
 #include "../shared/include/hash_utils.h"
+#include "../shared/include/bounded_queue.h"
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <thread>
 #include <curl/curl.h>
 #include <json/json.h>
 
-Decryptor::Decryptor() {
-    // Initialize any required resources
+// Password-derived keys kept while this decryptor runs, so capsules sealed
+// with the same password and salt skip the repeated PBKDF2 work
+static const size_t kDerivedKeyCacheSize = 16;
+
+// Parsed RSA private keys kept likewise, so a batch of capsules for the
+// same receiver decodes and checks the key once
+static const size_t kRSAKeyCacheSize = 4;
+
+// Streamed downloads are handed to the decrypt stage in pieces of about this
+// size, with at most kStreamQueueDepth pieces waiting between stages
+static const size_t kStreamPieceSize = 1 << 20;
+static const size_t kStreamQueueDepth = 4;
+
+Decryptor::Decryptor()
+    : derived_key_cache_(kDerivedKeyCacheSize), rsa_key_cache_(kRSAKeyCacheSize) {
 }
 
 Decryptor::~Decryptor() {
-    // Cleanup if needed
+    // The caches are zeroized when the last decryptor sharing them is gone
 }
 
 bool Decryptor::downloadAndDecrypt(const DecryptionConfig& config) {
@@ -61,12 +77,21 @@ bool Decryptor::downloadAndDecrypt(const DecryptionConfig& config) {
         std::string compressed_file_path = config.output_dir + "/compressed_file.bin";
         std::string output_file_path = config.output_dir + "/" + capsule_info.original_filename;
         
-        // Step 2: Download encrypted file
-        std::cout << "Step 2: Downloading encrypted file..." << std::endl;
+        // Step 2: Download encrypted file; a --range request fetches only
+        // the chunks it needs once the key is known, and streamed capsules
+        // are downloaded as they are decrypted in step 5
         std::string file_url = config.server_url + "/api/release/download/file/" + config.capsule_id;
-        if (!downloadFile(file_url, encrypted_file_path)) {
-            std::cerr << "Failed to download encrypted file" << std::endl;
-            return false;
+        bool stream = config.range.empty() && config.stream && isStreamable(file_url);
+        if (!config.range.empty()) {
+            std::cout << "Step 2: Skipping full download (range " << config.range << ")" << std::endl;
+        } else if (stream) {
+            std::cout << "Step 2: Deferring download to streamed decryption" << std::endl;
+        } else {
+            std::cout << "Step 2: Downloading encrypted file..." << std::endl;
+            if (!downloadFile(file_url, encrypted_file_path)) {
+                std::cerr << "Failed to download encrypted file" << std::endl;
+                return false;
+            }
         }
         
         // Step 3: Download encrypted key package
@@ -81,7 +106,9 @@ bool Decryptor::downloadAndDecrypt(const DecryptionConfig& config) {
         // Step 4: Decrypt key package
         std::cout << "Step 4: Decrypting key package..." << std::endl;
         std::vector<uint8_t> aes_key, salt, iv;
-        if (!decryptKeyPackage(encrypted_key_path, config.private_key_path, aes_key, salt, iv)) {
+        KdfParams kdf;
+        std::shared_ptr<const RSAKey> private_key = RSAKey::loadFromFile(config.private_key_path, true);
+        if (!private_key || !decryptKeyPackage(encrypted_key_path, *private_key, aes_key, salt, iv, kdf)) {
             std::cerr << "Failed to decrypt key package" << std::endl;
             cleanupDownloadedFiles(config);
             return false;
@@ -90,36 +117,100 @@ bool Decryptor::downloadAndDecrypt(const DecryptionConfig& config) {
         // If password was provided during encryption, derive the key
         if (!config.password.empty()) {
             std::cout << "Step 4a: Deriving AES key from password..." << std::endl;
-            if (!deriveAESKeyFromPassword(salt, config.password, aes_key)) {
+            if (!deriveAESKeyFromPassword(salt, config.password, kdf, aes_key)) {
                 std::cerr << "Failed to derive AES key from password" << std::endl;
                 cleanupDownloadedFiles(config);
                 return false;
             }
         }
         
-        // Step 5: Decrypt the file
-        std::cout << "Step 5: Decrypting file..." << std::endl;
-        if (!decryptFile(encrypted_file_path, compressed_file_path, aes_key, iv)) {
-            std::cerr << "Failed to decrypt file" << std::endl;
+        // A range is fetched and decrypted chunk by chunk; each chunk is
+        // authenticated by its GCM tag, while the capsule hash covers only
+        // the whole file
+        if (!config.range.empty()) {
+            std::cout << "Step 5: Fetching and decrypting range " << config.range << "..." << std::endl;
+            uint64_t offset = 0, length = 0;
+            SeekableCapsule::parseRange(config.range, offset, length);
+            std::string part_file_path = output_file_path + ".part";
+            SeekableCapsule::RangeReader reader = [this, &file_url](uint64_t at, size_t size,
+                                                                   std::vector<uint8_t>& data) {
+                return fetchRange(file_url, at, size, data);
+            };
+            if (!SeekableCapsule::decryptRange(reader, aes_key, offset, length, part_file_path,
+                                               config.threads)) {
+                std::cerr << "Failed to decrypt range (only seekable capsules support --range)" << std::endl;
+                cleanupDownloadedFiles(config);
+                return false;
+            }
+            
             cleanupDownloadedFiles(config);
-            return false;
+            std::cout << "✅ Range decrypted and verified chunk by chunk" << std::endl;
+            std::cout << "📁 Output file: " << part_file_path << std::endl;
+            return true;
         }
         
-        // Step 6: Decompress the file
-        std::cout << "Step 6: Decompressing file..." << std::endl;
-        if (!decompressFile(compressed_file_path, output_file_path)) {
-            std::cerr << "Failed to decompress file" << std::endl;
-            cleanupDownloadedFiles(config);
-            return false;
+        // The sender's hash covers the capsule as uploaded, so it is checked
+        // against the downloaded bytes rather than the decrypted output;
+        // a downloaded capsule is verified before anything is decrypted
+        if (!stream) {
+            std::cout << "Step 5: Verifying file integrity..." << std::endl;
+            bool verified = capsule_info.tree_hash.empty()
+                ? verifyFileHash(encrypted_file_path, capsule_info.sha256_hash)
+                : verifyFileTreeHash(encrypted_file_path, capsule_info.tree_hash, config.threads);
+            if (!verified) {
+                std::cerr << "File integrity check failed!" << std::endl;
+                std::cerr << "The file may have been tampered with or corrupted." << std::endl;
+                cleanupDownloadedFiles(config);
+                return false;
+            }
         }
         
-        // Step 7: Verify file integrity
-        std::cout << "Step 7: Verifying file integrity..." << std::endl;
-        if (!verifyFileHash(output_file_path, capsule_info.sha256_hash)) {
-            std::cerr << "File integrity check failed!" << std::endl;
-            std::cerr << "The file may have been tampered with or corrupted." << std::endl;
-            cleanupDownloadedFiles(config);
-            return false;
+        if (stream) {
+            std::cout << "Step 5: Downloading, decrypting and decompressing..." << std::endl;
+            std::string capsule_hash;
+            if (!streamDecrypt(file_url, output_file_path, aes_key, iv, config.threads,
+                               capsule_info.tree_hash, capsule_hash)) {
+                std::cerr << "Failed to decrypt file" << std::endl;
+                cleanupDownloadedFiles(config);
+                return false;
+            }
+            
+            std::cout << "Step 6: Verifying file integrity..." << std::endl;
+            // With a tree hash, every chunk was already checked as it arrived
+            if (capsule_info.tree_hash.empty() && capsule_hash != capsule_info.sha256_hash) {
+                std::cerr << "Hash mismatch!" << std::endl;
+                std::cerr << "Expected: " << capsule_info.sha256_hash << std::endl;
+                std::cerr << "Actual:   " << capsule_hash << std::endl;
+                std::cerr << "The file may have been tampered with or corrupted." << std::endl;
+                std::remove(output_file_path.c_str());
+                cleanupDownloadedFiles(config);
+                return false;
+            }
+            std::cout << "✅ File integrity verified successfully" << std::endl;
+        } else if (SeekableCapsule::isSeekableFile(encrypted_file_path)) {
+            // Chunks are decompressed as they are opened
+            std::cout << "Step 6: Decrypting and decompressing seekable capsule..." << std::endl;
+            if (!SeekableCapsule::decryptFile(encrypted_file_path, output_file_path, aes_key,
+                                              config.threads)) {
+                std::cerr << "Failed to decrypt file" << std::endl;
+                cleanupDownloadedFiles(config);
+                return false;
+            }
+        } else {
+            std::cout << "Step 6: Decrypting file..." << std::endl;
+            if (!decryptFile(encrypted_file_path, compressed_file_path, aes_key, iv, config.threads)) {
+                std::cerr << "Failed to decrypt file" << std::endl;
+                cleanupDownloadedFiles(config);
+                return false;
+            }
+            
+            // Step 7: Decompress the file
+            std::cout << "Step 7: Decompressing file..." << std::endl;
+            if (!decompressFile(compressed_file_path, output_file_path, config.threads)) {
+                std::cerr << "Failed to decompress file" << std::endl;
+                cleanupDownloadedFiles(config);
+                return false;
+            }
         }
         
         // Cleanup temporary files
@@ -172,6 +263,7 @@ bool Decryptor::getCapsuleInfo(const std::string& server_url, const std::string&
         info.original_filename = capsule["original_filename"].asString();
         info.file_size = capsule["file_size"].asUInt64();
         info.sha256_hash = capsule["sha256_hash"].asString();
+        info.tree_hash = capsule["tree_hash"].asString();
         info.release_time = capsule["release_time"].asString();
         info.status = capsule["status"].asString();
         info.created_at = capsule["created_at"].asString();
@@ -189,11 +281,282 @@ bool Decryptor::downloadFile(const std::string& url, const std::string& output_p
     return ReceiverUtils::downloadFromUrl(url, output_path);
 }
 
+// Collects a ranged response, refusing more than the requested length so a
+// server that ignores Range cannot stream the whole capsule into memory
+struct RangeResponse {
+    std::vector<uint8_t>* data;
+    size_t limit;
+};
+
+static size_t range_write_callback(void* ptr, size_t size, size_t nmemb, void* userdata) {
+    RangeResponse* response = static_cast<RangeResponse*>(userdata);
+    size_t bytes = size * nmemb;
+    if (response->data->size() + bytes > response->limit) {
+        return 0;
+    }
+    const uint8_t* begin = static_cast<const uint8_t*>(ptr);
+    response->data->insert(response->data->end(), begin, begin + bytes);
+    return bytes;
+}
+
+bool Decryptor::fetchRange(const std::string& url, uint64_t offset, size_t length,
+                           std::vector<uint8_t>& data) {
+    data.clear();
+    if (length == 0) {
+        return true;
+    }
+    
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        std::cerr << "Failed to initialize CURL" << std::endl;
+        return false;
+    }
+    
+    std::string range = std::to_string(offset) + "-" + std::to_string(offset + length - 1);
+    RangeResponse response = {&data, length};
+    data.reserve(length);
+    
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "TimeCapsule-Receiver/1.0");
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, range_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    
+    CURLcode res = curl_easy_perform(curl);
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    curl_easy_cleanup(curl);
+    
+    if (http_code != 206) {
+        std::cerr << "Server did not return byte range " << range << " (HTTP " << http_code << ")" << std::endl;
+        return false;
+    }
+    if (res != CURLE_OK) {
+        std::cerr << "CURL error: " << curl_easy_strerror(res) << std::endl;
+        return false;
+    }
+    return data.size() == length;
+}
+
+bool Decryptor::isStreamable(const std::string& url) {
+    // Seekable capsules are read through their index, so they are still
+    // downloaded first; so is everything when the server ignores ranges
+    std::vector<uint8_t> prefix;
+    if (!fetchRange(url, 0, SeekableCapsule::kPrefixSize, prefix)) {
+        std::cout << "Range probe failed; downloading the capsule before decrypting" << std::endl;
+        return false;
+    }
+    return !SeekableCapsule::isSeekablePrefix(prefix.data());
+}
+
+static void reportCorruptChunks(const std::vector<size_t>& corrupt_chunks, size_t chunk_size) {
+    for (size_t chunk : corrupt_chunks) {
+        std::cerr << "Corrupt chunk " << chunk << ": bytes " << chunk * chunk_size
+                  << "-" << (chunk + 1) * chunk_size - 1 << std::endl;
+    }
+}
+
+// Batches libcurl's small writes into pieces for the decrypt stage and
+// hashes the capsule bytes as they arrive: with an expected tree, leaf by
+// leaf against it, otherwise into a single SHA-256
+struct StreamDownload {
+    BoundedQueue<std::vector<uint8_t>>* queue;
+    std::vector<uint8_t> piece;
+    HashUtils* hasher;
+    const HashUtils::TreeHash* expected_tree; // Null without a tree hash
+    HashUtils::TreeHasher* tree_hasher;
+    size_t leaves_checked;
+    std::vector<size_t> corrupt_chunks;
+};
+
+// Checks the leaves completed since the last call; extra ones are corrupt
+static bool checkTreeLeaves(StreamDownload& download, const std::vector<std::string>& leaves) {
+    const std::vector<std::string>& expected = download.expected_tree->leaves;
+    for (size_t i = download.leaves_checked; i < leaves.size(); i++) {
+        if (i >= expected.size() || !HashUtils::compareHashes(leaves[i], expected[i])) {
+            download.corrupt_chunks.push_back(i);
+        }
+    }
+    download.leaves_checked = leaves.size();
+    return download.corrupt_chunks.empty();
+}
+
+static size_t stream_write_callback(void* ptr, size_t size, size_t nmemb, void* userdata) {
+    StreamDownload* download = static_cast<StreamDownload*>(userdata);
+    size_t bytes = size * nmemb;
+    const uint8_t* begin = static_cast<const uint8_t*>(ptr);
+    if (download->expected_tree) {
+        download->tree_hasher->update(begin, bytes);
+        if (!checkTreeLeaves(*download, download->tree_hasher->leaves())) {
+            download->queue->cancel();
+            return 0;
+        }
+    } else {
+        download->hasher->update(begin, bytes);
+    }
+    download->piece.insert(download->piece.end(), begin, begin + bytes);
+    if (download->piece.size() >= kStreamPieceSize) {
+        if (!download->queue->push(std::move(download->piece))) {
+            return 0; // A later stage failed; abort the transfer
+        }
+        download->piece.clear();
+        download->piece.reserve(kStreamPieceSize + bytes);
+    }
+    return bytes;
+}
+
+bool Decryptor::streamDecrypt(const std::string& url, const std::string& output_file_path,
+                              const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv,
+                              size_t threads, const std::string& tree_hash, std::string& capsule_hash) {
+    // The leaf list travels with the root, so it is only trusted once it
+    // reproduces the root
+    HashUtils::TreeHash expected_tree;
+    if (!tree_hash.empty() &&
+        (!HashUtils::parseTreeHash(tree_hash, expected_tree) ||
+         !HashUtils::compareHashes(HashUtils::computeTreeRoot(expected_tree.leaves), expected_tree.root))) {
+        std::cerr << "Invalid tree hash in capsule metadata" << std::endl;
+        return false;
+    }
+    
+    std::unique_ptr<CapsuleDecryptor> decryptor = AESCrypto::createDecryptor(key, iv, threads);
+    if (!decryptor) {
+        return false;
+    }
+    
+    std::ofstream out_file(output_file_path, std::ios::binary);
+    if (!out_file) {
+        std::cerr << "Cannot create output file: " << output_file_path << std::endl;
+        return false;
+    }
+    
+    bool write_ok = true;
+    std::unique_ptr<StreamDecompressor> decompressor = createStreamDecompressor(
+        [&out_file, &write_ok](std::vector<uint8_t>&& block) {
+            out_file.write(reinterpret_cast<const char*>(block.data()), block.size());
+            write_ok = !out_file.fail();
+            return write_ok;
+        }, threads);
+    
+    // libcurl delivers into the download queue on its own thread, a second
+    // thread feeds the decryptor's workers in order, and this one
+    // decompresses and writes. Queues are bounded, so a slow disk throttles
+    // the download instead of buffering it.
+    BoundedQueue<std::vector<uint8_t>> downloaded(kStreamQueueDepth);
+    BoundedQueue<std::vector<uint8_t>> decrypted(kStreamQueueDepth);
+    HashUtils hasher;
+    HashUtils::TreeHasher tree_hasher(expected_tree.chunk_size);
+    std::vector<size_t> corrupt_chunks;
+    bool download_ok = false;
+    bool decrypt_ok = false;
+    
+    std::thread download_stage([&]() {
+        CURL* curl = curl_easy_init();
+        if (!curl) {
+            std::cerr << "Failed to initialize CURL" << std::endl;
+            downloaded.cancel();
+            return;
+        }
+        
+        StreamDownload download = {&downloaded, std::vector<uint8_t>(), &hasher,
+                                   tree_hash.empty() ? nullptr : &expected_tree, &tree_hasher, 0,
+                                   std::vector<size_t>()};
+        download.piece.reserve(kStreamPieceSize);
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, "TimeCapsule-Receiver/1.0");
+        curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, stream_write_callback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &download);
+        CURLcode res = curl_easy_perform(curl);
+        curl_easy_cleanup(curl);
+        
+        if (res != CURLE_OK) {
+            if (!downloaded.cancelled()) {
+                std::cerr << "CURL error: " << curl_easy_strerror(res) << std::endl;
+            }
+            downloaded.cancel();
+            corrupt_chunks.swap(download.corrupt_chunks);
+            return;
+        }
+        if (download.expected_tree) {
+            // The last leaf, and any the download fell short of
+            HashUtils::TreeHash tree;
+            tree_hasher.finish(tree);
+            checkTreeLeaves(download, tree.leaves);
+            for (size_t i = tree.leaves.size(); i < expected_tree.leaves.size(); i++) {
+                download.corrupt_chunks.push_back(i);
+            }
+            if (!download.corrupt_chunks.empty()) {
+                downloaded.cancel();
+                corrupt_chunks.swap(download.corrupt_chunks);
+                return;
+            }
+        }
+        if (!download.piece.empty() && !downloaded.push(std::move(download.piece))) {
+            return;
+        }
+        downloaded.close();
+        download_ok = true;
+    });
+    
+    std::thread decrypt_stage([&]() {
+        std::vector<uint8_t> piece;
+        while (downloaded.pop(piece)) {
+            std::vector<uint8_t> plaintext;
+            if (!decryptor->update(piece.data(), piece.size(), plaintext) ||
+                (!plaintext.empty() && !decrypted.push(std::move(plaintext)))) {
+                downloaded.cancel();
+                decrypted.cancel();
+                return;
+            }
+        }
+        
+        std::vector<uint8_t> plaintext;
+        if (downloaded.cancelled() || !decryptor->finish(plaintext) ||
+            (!plaintext.empty() && !decrypted.push(std::move(plaintext)))) {
+            decrypted.cancel();
+            return;
+        }
+        decrypted.close();
+        decrypt_ok = true;
+    });
+    
+    bool decompress_ok = true;
+    std::vector<uint8_t> piece;
+    while (decrypted.pop(piece)) {
+        if (!decompressor->update(piece.data(), piece.size())) {
+            if (!write_ok) {
+                std::cerr << "Failed to write output file" << std::endl;
+            }
+            decompress_ok = false;
+            decrypted.cancel();
+            downloaded.cancel();
+            break;
+        }
+    }
+    
+    download_stage.join();
+    decrypt_stage.join();
+    reportCorruptChunks(corrupt_chunks, expected_tree.chunk_size);
+    
+    decompress_ok = decompress_ok && download_ok && decrypt_ok && decompressor->finish();
+    out_file.close();
+    if (!decompress_ok || out_file.fail()) {
+        std::remove(output_file_path.c_str());
+        return false;
+    }
+    
+    if (tree_hash.empty()) {
+        capsule_hash = hasher.finalize();
+    }
+    return true;
+}
+
 bool Decryptor::decryptKeyPackage(const std::string& encrypted_key_path, 
-                                 const std::string& private_key_path,
+                                 const RSAKey& private_key,
                                  std::vector<uint8_t>& aes_key,
                                  std::vector<uint8_t>& salt,
-                                 std::vector<uint8_t>& iv) {
+                                 std::vector<uint8_t>& iv,
+                                 KdfParams& kdf) {
     try {
         // Read encrypted key package
         std::vector<uint8_t> encrypted_data;
@@ -205,7 +568,7 @@ bool Decryptor::decryptKeyPackage(const std::string& encrypted_key_path,
         // Decrypt with RSA
         RSACrypto rsa;
         std::vector<uint8_t> decrypted_data;
-        if (!rsa.decryptFile(private_key_path, encrypted_data, decrypted_data)) {
+        if (!rsa.decryptFile(private_key, encrypted_data, decrypted_data)) {
             std::cerr << "Failed to decrypt key package with RSA" << std::endl;
             return false;
         }
@@ -217,24 +580,28 @@ bool Decryptor::decryptKeyPackage(const std::string& encrypted_key_path,
             return false;
         }
         
-        // Extract components (structure: key_size(1) + key + salt_size(1) + salt + iv_size(1) + iv)
+        // Extract components (structure: key_size(1) + key + salt_size(1) + salt + iv_size(1) + iv
+        // + optional KDF parameter block)
+        // Every size byte and the field it announces must lie inside the package
         size_t pos = 0;
+        auto readField = [&key_package, &pos](std::vector<uint8_t>& field) {
+            if (pos >= key_package.size() || key_package[pos] > key_package.size() - pos - 1) {
+                std::cerr << "Malformed key package" << std::endl;
+                return false;
+            }
+            size_t size = key_package[pos++];
+            field.assign(key_package.begin() + pos, key_package.begin() + pos + size);
+            pos += size;
+            return true;
+        };
+        
+        // Extract key, salt and IV
+        if (!readField(aes_key) || !readField(salt) || !readField(iv)) {
+            return false;
+        }
         
-        // Extract key
-        uint8_t key_size = key_package[pos++];
-        aes_key.assign(key_package.begin() + pos, key_package.begin() + pos + key_size);
-        pos += key_size;
-        
-        // Extract salt
-        uint8_t salt_size = key_package[pos++];
-        salt.assign(key_package.begin() + pos, key_package.begin() + pos + salt_size);
-        pos += salt_size;
-        
-        // Extract IV
-        uint8_t iv_size = key_package[pos++];
-        iv.assign(key_package.begin() + pos, key_package.begin() + pos + iv_size);
-        
-        return true;
+        // Extract KDF parameters; older packages used PBKDF2 with 100,000 iterations
+        return readKdfBlock(key_package, pos, kdf);
         
     } catch (const std::exception& e) {
         std::cerr << "Key package decryption error: " << e.what() << std::endl;
@@ -245,10 +612,15 @@ bool Decryptor::decryptKeyPackage(const std::string& encrypted_key_path,
 bool Decryptor::decryptFile(const std::string& encrypted_file_path,
                            const std::string& output_file_path,
                            const std::vector<uint8_t>& key,
-                           const std::vector<uint8_t>& iv) {
+                           const std::vector<uint8_t>& iv,
+                           size_t threads) {
     try {
         AESCrypto aes;
-        return aes.decryptFile(encrypted_file_path, output_file_path, key, iv);
+        // GCM capsules carry their own header; anything else is plain CBC
+        if (AESCrypto::isGCMFile(encrypted_file_path)) {
+            return aes.decryptFileGCM(encrypted_file_path, output_file_path, key, threads);
+        }
+        return aes.decryptFile(encrypted_file_path, output_file_path, key, iv, threads);
     } catch (const std::exception& e) {
         std::cerr << "File decryption error: " << e.what() << std::endl;
         return false;
@@ -256,10 +628,18 @@ bool Decryptor::decryptFile(const std::string& encrypted_file_path,
 }
 
 bool Decryptor::decompressFile(const std::string& compressed_file_path, 
-                              const std::string& output_file_path) {
+                              const std::string& output_file_path,
+                              size_t threads) {
     try {
-        HuffmanCompressor compressor;
-        return compressor.decompressFile(compressed_file_path, output_file_path);
+        // The codec ID in the file header picks the decoder
+        CodecId id;
+        if (!readCodecId(compressed_file_path, id)) {
+            return false;
+        }
+        std::unique_ptr<CompressionCodec> codec = createCodec(id);
+        codec->setThreadCount(threads);
+        std::cout << "Codec: " << codecName(id) << std::endl;
+        return codec->decompressFile(compressed_file_path, output_file_path);
     } catch (const std::exception& e) {
         std::cerr << "Decompression error: " << e.what() << std::endl;
         return false;
@@ -287,6 +667,25 @@ bool Decryptor::verifyFileHash(const std::string& file_path, const std::string&
     }
 }
 
+bool Decryptor::verifyFileTreeHash(const std::string& file_path, const std::string& tree_hash,
+                                   size_t threads) {
+    HashUtils::TreeHash tree;
+    if (!HashUtils::parseTreeHash(tree_hash, tree)) {
+        std::cerr << "Invalid tree hash in capsule metadata" << std::endl;
+        return false;
+    }
+    
+    HashUtils hasher;
+    std::vector<size_t> corrupt_chunks;
+    if (!hasher.verifyFileTreeHash(file_path, tree, corrupt_chunks, threads)) {
+        reportCorruptChunks(corrupt_chunks, tree.chunk_size);
+        return false;
+    }
+    
+    std::cout << "✅ File integrity verified successfully (" << tree.leaves.size() << " chunks)" << std::endl;
+    return true;
+}
+
 bool Decryptor::cleanupDownloadedFiles(const DecryptionConfig& config) {
     bool success = true;
     
@@ -332,7 +731,8 @@ bool Decryptor::validateConfig(const DecryptionConfig& config) {
         return false;
     }
     
-    if (!ReceiverUtils::isValidPrivateKey(config.private_key_path)) {
+    // Parsed once here and taken from the key cache in step 4
+    if (!RSAKey::loadFromFile(config.private_key_path, true)) {
         std::cerr << "Invalid private key file: " << config.private_key_path << std::endl;
         return false;
     }
@@ -342,14 +742,21 @@ bool Decryptor::validateConfig(const DecryptionConfig& config) {
         return false;
     }
     
+    uint64_t offset = 0, length = 0;
+    if (!config.range.empty() && !SeekableCapsule::parseRange(config.range, offset, length)) {
+        std::cerr << "Invalid range (expected START-END or START-): " << config.range << std::endl;
+        return false;
+    }
+    
     return true;
 }
 
 bool Decryptor::deriveAESKeyFromPassword(const std::vector<uint8_t>& salt, 
                                         const std::string& password,
+                                        const KdfParams& kdf,
                                         std::vector<uint8_t>& key) {
     try {
-        key = AESCrypto::deriveKeyPBKDF2(password, salt, 32, 100000);
+        key = deriveKey(password, salt, 32, kdf);
         return !key.empty();
     } catch (const std::exception& e) {
         std::cerr << "Password derivation error: " << e.what() << std::endl;
@@ -4,6 +4,10 @@
 #include <string>
 #include <vector>
 
+#include "../../shared/include/kdf.h"
+#include "../../shared/include/aes_cbc.h"
+#include "../../shared/include/rsa_key.h"
+
 struct DecryptionConfig {
     std::string capsule_id;
     std::string receiver_id;
@@ -11,6 +15,11 @@ struct DecryptionConfig {
     std::string output_dir = ".";
     std::string server_url = "http://localhost:3000";
     std::string password; // Only if password was used during encryption
+    int threads = 0;      // Worker threads for decryption and decompression (--threads, 0 = all cores)
+    std::string range;    // --range START-END: decrypt only these plaintext bytes (seekable capsules)
+    // Decrypt and decompress CBC and GCM capsules while they download,
+    // writing only the output file (--no-stream downloads them first)
+    bool stream = true;
     
     // Downloaded files
     std::string encrypted_file_path;
@@ -24,6 +33,7 @@ struct CapsuleInfo {
     std::string original_filename;
     size_t file_size;
     std::string sha256_hash;
+    std::string tree_hash; // HashUtils::serializeTreeHash form; empty if the sender sent none
     std::string release_time;
     std::string status;
     std::string created_at;
@@ -41,18 +51,35 @@ public:
     // Individual steps
     bool getCapsuleInfo(const std::string& server_url, const std::string& capsule_id, CapsuleInfo& info);
     bool downloadFile(const std::string& url, const std::string& output_path);
+    bool fetchRange(const std::string& url, uint64_t offset, size_t length, std::vector<uint8_t>& data);
     bool decryptKeyPackage(const std::string& encrypted_key_path, 
-                          const std::string& private_key_path,
+                          const RSAKey& private_key,
                           std::vector<uint8_t>& aes_key,
                           std::vector<uint8_t>& salt,
-                          std::vector<uint8_t>& iv);
+                          std::vector<uint8_t>& iv,
+                          KdfParams& kdf);
     bool decryptFile(const std::string& encrypted_file_path,
                     const std::string& output_file_path,
                     const std::vector<uint8_t>& key,
-                    const std::vector<uint8_t>& iv);
+                    const std::vector<uint8_t>& iv,
+                    size_t threads = 0);
+    // Downloads, decrypts and decompresses in one pass, writing only
+    // output_file_path; the output is removed on failure. With a serialized
+    // tree_hash, each chunk of the download is checked against its leaf as
+    // it completes and the transfer stops at the first corrupt chunk, which
+    // is reported. Otherwise capsule_hash receives the SHA-256 of the bytes
+    // downloaded.
+    bool streamDecrypt(const std::string& url, const std::string& output_file_path,
+                      const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv,
+                      size_t threads, const std::string& tree_hash, std::string& capsule_hash);
     bool decompressFile(const std::string& compressed_file_path, 
-                       const std::string& output_file_path);
+                       const std::string& output_file_path,
+                       size_t threads = 0);
     bool verifyFileHash(const std::string& file_path, const std::string& expected_hash);
+    // Checks the chunks of file_path in parallel against a serialized tree
+    // hash and reports the byte range of every chunk that differs
+    bool verifyFileTreeHash(const std::string& file_path, const std::string& tree_hash,
+                           size_t threads = 0);
     
     // Utility functions
     bool cleanupDownloadedFiles(const DecryptionConfig& config);
@@ -60,9 +87,16 @@ public:
     
 private:
     bool validateConfig(const DecryptionConfig& config);
+    bool isStreamable(const std::string& url);
     bool deriveAESKeyFromPassword(const std::vector<uint8_t>& salt, 
                                  const std::string& password,
+                                 const KdfParams& kdf,
                                  std::vector<uint8_t>& key);
+    
+    // Keep the process-wide password-key and RSA key caches enabled while
+    // this decryptor is alive
+    AESCrypto::KeyCacheScope derived_key_cache_;
+    RSAKey::KeyCacheScope rsa_key_cache_;
 };
 
 #endif // DECRYPTOR_H
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "keygen.h"
 #include "../shared/include/rsa_utils.h"
+#include "../shared/include/encoding.h"
 #include "utils.h"
 
 #include <iostream>
@@ -165,16 +166,23 @@ bool KeyGenerator::validateKeyPair(const std::string& private_key_path, const st
         }
         
         // Test encryption/decryption with the key pair
+        std::shared_ptr<const RSAKey> public_rsa_key = RSAKey::fromPem(public_key, false);
+        std::shared_ptr<const RSAKey> private_rsa_key = RSAKey::fromPem(private_key, true);
+        if (!public_rsa_key || !private_rsa_key) {
+            std::cerr << "Cannot parse key pair" << std::endl;
+            return false;
+        }
+        
         RSACrypto rsa;
         std::string test_message = "TimeCapsule Key Validation Test";
         std::string encrypted, decrypted;
         
-        if (!rsa.encryptWithPublicKey(public_key, test_message, encrypted)) {
+        if (!rsa.encryptWithPublicKey(*public_rsa_key, test_message, encrypted)) {
             std::cerr << "Encryption test failed" << std::endl;
             return false;
         }
         
-        if (!rsa.decryptWithPrivateKey(private_key, encrypted, decrypted)) {
+        if (!rsa.decryptWithPrivateKey(*private_rsa_key, encrypted, decrypted)) {
             std::cerr << "Decryption test failed" << std::endl;
             return false;
         }
@@ -200,17 +208,19 @@ std::string KeyGenerator::getKeyFingerprint(const std::string& key_data) {
     SHA256_Update(&sha256, key_data.c_str(), key_data.length());
     SHA256_Final(hash, &sha256);
     
-    std::stringstream ss;
-    ss << std::hex << std::setfill('0');
+    char digits[2 * SHA256_DIGEST_LENGTH];
+    Encoding::hexEncode(hash, SHA256_DIGEST_LENGTH, digits);
     
+    std::string fingerprint;
+    fingerprint.reserve(3 * SHA256_DIGEST_LENGTH - 1);
     for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        ss << std::setw(2) << static_cast<unsigned int>(hash[i]);
-        if (i < SHA256_DIGEST_LENGTH - 1) {
-            ss << ":";
+        if (i > 0) {
+            fingerprint += ':';
         }
+        fingerprint.append(digits + 2 * i, 2);
     }
     
-    return ss.str();
+    return fingerprint;
 }
 
 void KeyGenerator::printKeyInfo(const std::string& public_key_path, const std::string& private_key_path) {
@@ -1,18 +1,33 @@
 #include "encryptor.h"
 #include "utils.h"
-#include "../shared/include/huffman.h"
+#include "../shared/include/codec.h"
 #include "../shared/include/aes_cbc.h"
+#include "../shared/include/seekable.h"
 #include "../shared/include/rsa_utils.h"
 #include "../shared/include/hash_utils.h"
+#include "../shared/include/bounded_queue.h"
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <random>
+#include <algorithm>
+#include <thread>
 #include <curl/curl.h>
 
-Encryptor::Encryptor() {
-    // Initialize Crypto++ if needed
+namespace {
+
+// Pieces (about one compression block each) queued between pipeline stages
+const size_t kPipelineDepth = 4;
+
+// Parsed RSA keys kept while this encryptor runs
+const size_t kRSAKeyCacheSize = 4;
+
+} // namespace
+
+Encryptor::Encryptor() : rsa_key_cache_(kRSAKeyCacheSize) {
+    // The receiver's public key is parsed once, in validateConfig, and
+    // reused for the key package
 }
 
 Encryptor::~Encryptor() {
@@ -29,42 +44,66 @@ bool Encryptor::encryptAndUpload(const EncryptionConfig& config) {
     }
     
     try {
-        // Step 1: Compress the file
-        std::cout << "Step 1: Compressing file..." << std::endl;
-        if (!compressFile(config.input_file, config.compressed_file)) {
-            std::cerr << "File compression failed" << std::endl;
+        // Step 1: Generate AES key
+        std::cout << "Step 1: Generating encryption keys..." << std::endl;
+        KdfParams kdf;
+        if (!resolveKdfParams(config, kdf)) {
+            std::cerr << "Invalid key derivation settings" << std::endl;
             return false;
         }
-        std::cout << "Compression completed: " << config.compressed_file << std::endl;
-        
-        // Step 2: Generate AES key
-        std::cout << "Step 2: Generating encryption keys..." << std::endl;
         std::vector<uint8_t> aes_key, salt, iv;
-        if (!generateAESKey(config.password, aes_key, salt, iv)) {
+        if (!generateAESKey(config.password, kdf, aes_key, salt, iv)) {
             std::cerr << "AES key generation failed" << std::endl;
             return false;
         }
         
-        // Step 3: Encrypt the compressed file
-        std::cout << "Step 3: Encrypting file..." << std::endl;
-        if (!encryptFile(config.compressed_file, config.encrypted_file, aes_key, iv)) {
-            std::cerr << "File encryption failed" << std::endl;
-            return false;
+        // Steps 2-4: Compress, encrypt and hash. CBC and GCM capsules do all
+        // three in one pass without a compressed temp file, tree hash
+        // included; seekable capsules compress each chunk as it is sealed.
+        std::string sha256_hash;
+        HashUtils::TreeHash tree;
+        if (config.cipher_mode == "seekable") {
+            std::cout << "Steps 2-3: Compressing and sealing chunks..." << std::endl;
+            if (!SeekableCapsule::encryptFile(config.input_file, config.encrypted_file, aes_key, iv,
+                                              config.compression_level, config.threads)) {
+                std::cerr << "File encryption failed" << std::endl;
+                return false;
+            }
+            std::cout << "Step 4: Computing file hash..." << std::endl;
+            sha256_hash = computeSHA256(config.encrypted_file);
+        } else {
+            std::cout << "Steps 2-4: Compressing, encrypting and hashing..." << std::endl;
+            if (!compressEncryptAndHash(config, aes_key, iv, sha256_hash, tree)) {
+                std::cerr << "File encryption failed" << std::endl;
+                return false;
+            }
         }
-        std::cout << "Encryption completed: " << config.encrypted_file << std::endl;
-        
-        // Step 4: Compute SHA256 hash
-        std::cout << "Step 4: Computing file hash..." << std::endl;
-        std::string sha256_hash = computeSHA256(config.encrypted_file);
         if (sha256_hash.empty()) {
             std::cerr << "SHA256 computation failed" << std::endl;
             return false;
         }
+        std::cout << "Encryption completed: " << config.encrypted_file << std::endl;
         std::cout << "File hash: " << sha256_hash << std::endl;
         
+        std::string tree_hash;
+        if (config.tree_hash) {
+            // Only seekable capsules still need a pass over the file for it
+            if (tree.leaves.empty()) {
+                std::cout << "Step 4a: Computing tree hash..." << std::endl;
+                HashUtils hasher;
+                if (!hasher.computeFileTreeHash(config.encrypted_file, tree, config.threads)) {
+                    std::cerr << "Tree hash computation failed" << std::endl;
+                    return false;
+                }
+            }
+            tree_hash = HashUtils::serializeTreeHash(tree);
+            std::cout << "Tree hash root: " << tree.root << " (" << tree.leaves.size() << " chunks)" << std::endl;
+        }
+        
         // Step 5: Create key package
         std::cout << "Step 5: Creating key package..." << std::endl;
-        if (!createKeyPackage(aes_key, salt, iv, config.receiver_public_key_path, config.key_package_file)) {
+        std::shared_ptr<const RSAKey> public_key = RSAKey::loadFromFile(config.receiver_public_key_path, false);
+        if (!public_key || !createKeyPackage(aes_key, salt, iv, kdf, *public_key, config.key_package_file)) {
             std::cerr << "Key package creation failed" << std::endl;
             return false;
         }
@@ -72,7 +111,7 @@ bool Encryptor::encryptAndUpload(const EncryptionConfig& config) {
         
         // Step 6: Upload to server
         std::cout << "Step 6: Uploading to server..." << std::endl;
-        if (!uploadToServer(config, sha256_hash)) {
+        if (!uploadToServer(config, sha256_hash, tree_hash)) {
             std::cerr << "Upload to server failed" << std::endl;
             return false;
         }
@@ -90,17 +129,20 @@ bool Encryptor::encryptAndUpload(const EncryptionConfig& config) {
     }
 }
 
-bool Encryptor::compressFile(const std::string& input_file, const std::string& output_file) {
+bool Encryptor::compressFile(const std::string& input_file, const std::string& output_file,
+                             size_t threads, int level) {
     try {
-        HuffmanCompressor compressor;
-        return compressor.compressFile(input_file, output_file);
+        std::unique_ptr<CompressionCodec> codec = createCodecForLevel(level);
+        codec->setThreadCount(threads);
+        std::cout << "Codec: " << codecName(codec->id()) << " (level " << level << ")" << std::endl;
+        return codec->compressFile(input_file, output_file);
     } catch (const std::exception& e) {
         std::cerr << "Compression error: " << e.what() << std::endl;
         return false;
     }
 }
 
-bool Encryptor::generateAESKey(const std::string& password, std::vector<uint8_t>& key, 
+bool Encryptor::generateAESKey(const std::string& password, const KdfParams& kdf, std::vector<uint8_t>& key, 
                               std::vector<uint8_t>& salt, std::vector<uint8_t>& iv) {
     try {
         // Generate random salt and IV
@@ -108,8 +150,8 @@ bool Encryptor::generateAESKey(const std::string& password, std::vector<uint8_t>
         iv = SenderUtils::generateRandomBytes(16);
         
         if (!password.empty()) {
-            // Use PBKDF2 to derive key from password
-            key = AESCrypto::deriveKeyPBKDF2(password, salt, 32, 100000);
+            // Derive key from password with the configured KDF
+            key = deriveKey(password, salt, 32, kdf);
         } else {
             // Generate random AES key
             key = SenderUtils::generateRandomBytes(32);
@@ -124,9 +166,13 @@ bool Encryptor::generateAESKey(const std::string& password, std::vector<uint8_t>
 }
 
 bool Encryptor::encryptFile(const std::string& input_file, const std::string& output_file,
-                           const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
+                           const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv,
+                           const std::string& mode, size_t threads) {
     try {
         AESCrypto aes;
+        if (mode == "gcm") {
+            return aes.encryptFileGCM(input_file, output_file, key, iv, threads);
+        }
         return aes.encryptFile(input_file, output_file, key, iv);
     } catch (const std::exception& e) {
         std::cerr << "Encryption error: " << e.what() << std::endl;
@@ -134,11 +180,113 @@ bool Encryptor::encryptFile(const std::string& input_file, const std::string& ou
     }
 }
 
+bool Encryptor::compressEncryptAndHash(const EncryptionConfig& config, const std::vector<uint8_t>& key,
+                                       const std::vector<uint8_t>& iv, std::string& sha256_hash,
+                                       HashUtils::TreeHash& tree) {
+    size_t threads = static_cast<size_t>(std::max(config.threads, 0));
+    std::unique_ptr<CapsuleEncryptor> encryptor = AESCrypto::createEncryptor(config.cipher_mode, key, iv,
+                                                                             threads);
+    if (!encryptor) {
+        return false;
+    }
+    
+    std::ofstream out_file(config.encrypted_file, std::ios::binary);
+    if (!out_file) {
+        std::cerr << "Cannot create output file: " << config.encrypted_file << std::endl;
+        return false;
+    }
+    
+    std::unique_ptr<CompressionCodec> codec = createCodecForLevel(config.compression_level);
+    codec->setThreadCount(threads);
+    std::cout << "Codec: " << codecName(codec->id()) << " (level " << config.compression_level << ")"
+              << ", cipher: " << config.cipher_mode << std::endl;
+    
+    // Compression and encryption run on their own threads, each spreading
+    // its work over its own workers; this thread hashes the ciphertext,
+    // tree leaves included, and writes it. Each queue holds at most
+    // kPipelineDepth pieces, so memory stays bounded however far one stage
+    // runs ahead.
+    BoundedQueue<std::vector<uint8_t>> compressed(kPipelineDepth);
+    BoundedQueue<std::vector<uint8_t>> encrypted(kPipelineDepth);
+    bool compress_ok = false;
+    bool encrypt_ok = false;
+    
+    std::thread compress_stage([&]() {
+        compress_ok = codec->compressFile(config.input_file, [&compressed](std::vector<uint8_t>&& piece) {
+            return compressed.push(std::move(piece));
+        });
+        if (compress_ok) {
+            compressed.close();
+        } else {
+            compressed.cancel();
+        }
+    });
+    
+    std::thread encrypt_stage([&]() {
+        std::vector<uint8_t> piece;
+        while (compressed.pop(piece)) {
+            std::vector<uint8_t> ciphertext;
+            if (!encryptor->update(piece.data(), piece.size(), ciphertext) ||
+                (!ciphertext.empty() && !encrypted.push(std::move(ciphertext)))) {
+                compressed.cancel();
+                encrypted.cancel();
+                return;
+            }
+        }
+        
+        std::vector<uint8_t> ciphertext;
+        if (compressed.cancelled() || !encryptor->finish(ciphertext) ||
+            !encrypted.push(std::move(ciphertext))) {
+            encrypted.cancel();
+            return;
+        }
+        encrypted.close();
+        encrypt_ok = true;
+    });
+    
+    HashUtils hasher;
+    HashUtils::TreeHasher tree_hasher;
+    bool write_ok = true;
+    std::vector<uint8_t> piece;
+    while (encrypted.pop(piece)) {
+        hasher.update(piece);
+        if (config.tree_hash) {
+            tree_hasher.update(piece);
+        }
+        out_file.write(reinterpret_cast<const char*>(piece.data()), piece.size());
+        if (out_file.fail()) {
+            std::cerr << "Failed to write encrypted file" << std::endl;
+            write_ok = false;
+            encrypted.cancel();
+            compressed.cancel();
+            break;
+        }
+    }
+    
+    compress_stage.join();
+    encrypt_stage.join();
+    out_file.close();
+    
+    if (!compress_ok || !encrypt_ok || !write_ok || out_file.fail()) {
+        std::remove(config.encrypted_file.c_str());
+        return false;
+    }
+    
+    sha256_hash = hasher.finalize();
+    if (config.tree_hash && !tree_hasher.finish(tree)) {
+        std::cerr << "Tree hash computation failed" << std::endl;
+        std::remove(config.encrypted_file.c_str());
+        return false;
+    }
+    return true;
+}
+
 bool Encryptor::createKeyPackage(const std::vector<uint8_t>& key, const std::vector<uint8_t>& salt,
-                                const std::vector<uint8_t>& iv, const std::string& public_key_path,
-                                const std::string& output_file) {
+                                const std::vector<uint8_t>& iv, const KdfParams& kdf,
+                                const RSAKey& public_key, const std::string& output_file) {
     try {
         // Create key package structure: key_size(1) + key + salt_size(1) + salt + iv_size(1) + iv
+        // + KDF parameter block (see kdf.h)
         std::vector<uint8_t> key_package;
         
         // Add key
@@ -153,9 +301,12 @@ bool Encryptor::createKeyPackage(const std::vector<uint8_t>& key, const std::vec
         key_package.push_back(static_cast<uint8_t>(iv.size()));
         key_package.insert(key_package.end(), iv.begin(), iv.end());
         
+        // Add KDF parameters
+        appendKdfBlock(key_package, kdf);
+        
         // Encrypt key package with RSA
         RSACrypto rsa;
-        return rsa.encryptFile(public_key_path, key_package, output_file);
+        return rsa.encryptFile(public_key, key_package, output_file);
         
     } catch (const std::exception& e) {
         std::cerr << "Key package creation error: " << e.what() << std::endl;
@@ -175,7 +326,8 @@ size_t write_callback(void* contents, size_t size, size_t nmemb, std::string* re
     return total_size;
 }
 
-bool Encryptor::uploadToServer(const EncryptionConfig& config, const std::string& sha256_hash) {
+bool Encryptor::uploadToServer(const EncryptionConfig& config, const std::string& sha256_hash,
+                               const std::string& tree_hash) {
     CURL* curl;
     CURLcode res;
     struct curl_httppost* formpost = NULL;
@@ -232,6 +384,13 @@ bool Encryptor::uploadToServer(const EncryptionConfig& config, const std::string
                     CURLFORM_COPYCONTENTS, sha256_hash.c_str(),
                     CURLFORM_END);
         
+        if (!tree_hash.empty()) {
+            curl_formadd(&formpost, &lastptr,
+                        CURLFORM_COPYNAME, "tree_hash",
+                        CURLFORM_COPYCONTENTS, tree_hash.c_str(),
+                        CURLFORM_END);
+        }
+        
         curl_formadd(&formpost, &lastptr,
                     CURLFORM_COPYNAME, "file_size",
                     CURLFORM_COPYCONTENTS, std::to_string(getFileSize(config.encrypted_file)).c_str(),
@@ -304,6 +463,37 @@ size_t Encryptor::getFileSize(const std::string& file_path) {
     return SenderUtils::getFileSize(file_path);
 }
 
+bool Encryptor::resolveKdfParams(const EncryptionConfig& config, KdfParams& kdf) {
+    if (!parseKdfAlgorithm(config.kdf, kdf.algorithm)) {
+        std::cerr << "Unknown KDF: " << config.kdf << std::endl;
+        return false;
+    }
+    
+    if (config.kdf_target_ms > 0) {
+        kdf = calibrateKdf(kdf.algorithm, config.kdf_target_ms);
+        std::cout << "KDF calibrated for " << config.kdf_target_ms << " ms: " << kdfName(kdf.algorithm);
+        if (kdf.algorithm == KdfAlgorithm::Scrypt) {
+            std::cout << ", " << kdf.memory_kib << " KiB" << std::endl;
+        } else {
+            std::cout << ", " << kdf.iterations << " iterations" << std::endl;
+        }
+    } else if (kdf.algorithm == KdfAlgorithm::Scrypt) {
+        kdf.iterations = 1;
+        kdf.memory_kib = static_cast<uint32_t>(std::max(config.kdf_memory_kib, 0));
+        kdf.parallelism = 1;
+    } else {
+        kdf.iterations = static_cast<uint32_t>(std::max(config.pbkdf2_iterations, 0));
+    }
+    
+    if (!validateKdfParams(kdf)) {
+        std::cerr << "Unsupported " << kdfName(kdf.algorithm) << " cost (PBKDF2 needs 10000 to "
+                  << "1073741824 iterations; scrypt memory must be a power of two from 1024 to "
+                  << "4194304 KiB)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
 void Encryptor::cleanupTempFiles(const EncryptionConfig& config) {
     try {
         if (SenderUtils::fileExists(config.compressed_file)) {
@@ -325,6 +515,11 @@ bool Encryptor::validateConfig(const EncryptionConfig& config) {
         return false;
     }
     
+    if (!RSAKey::loadFromFile(config.receiver_public_key_path, false)) {
+        std::cerr << "Invalid receiver public key: " << config.receiver_public_key_path << std::endl;
+        return false;
+    }
+    
     if (config.receiver_id.empty()) {
         std::cerr << "Receiver ID cannot be empty" << std::endl;
         return false;
@@ -340,5 +535,17 @@ bool Encryptor::validateConfig(const EncryptionConfig& config) {
         return false;
     }
     
+    if (config.cipher_mode != "cbc" && config.cipher_mode != "gcm" &&
+        config.cipher_mode != "seekable") {
+        std::cerr << "Unknown cipher mode: " << config.cipher_mode << std::endl;
+        return false;
+    }
+    
+    KdfAlgorithm kdf_algorithm;
+    if (!parseKdfAlgorithm(config.kdf, kdf_algorithm)) {
+        std::cerr << "Unknown KDF (expected pbkdf2 or scrypt): " << config.kdf << std::endl;
+        return false;
+    }
+    
     return true;
 }
\ No newline at end of file
@@ -4,6 +4,10 @@
 #include <string>
 #include <vector>
 
+#include "../../shared/include/kdf.h"
+#include "../../shared/include/rsa_key.h"
+#include "../../shared/include/hash_utils.h"
+
 struct EncryptionConfig {
     std::string input_file;
     std::string receiver_id;
@@ -23,6 +27,29 @@ struct EncryptionConfig {
     int salt_size = 16;
     int iv_size = 16;
     int pbkdf2_iterations = 100000;
+    
+    // Password KDF (--kdf): "pbkdf2" runs pbkdf2_iterations, "scrypt" uses
+    // kdf_memory_kib. --kdf-target-ms > 0 instead calibrates the cost so one
+    // derivation takes about that long here. Recorded in the key package.
+    std::string kdf = "pbkdf2";
+    int kdf_memory_kib = 65536;
+    int kdf_target_ms = 0;
+    
+    // Worker threads for compression and for GCM sealing, each stage with a
+    // pool of its own (--threads, 0 = all cores); CBC encrypts on one thread
+    int threads = 0;
+    
+    // Compression level (--level): 0 store, 1-3 Huffman, 4-9 LZ77 + Huffman
+    int compression_level = 6;
+    
+    // Cipher mode (--cipher): "cbc", "gcm" (chunked, authenticated, parallel)
+    // or "seekable" (chunks compressed and sealed separately, so receivers
+    // can decrypt a byte range without the rest of the capsule)
+    std::string cipher_mode = "cbc";
+    
+    // Upload a chunked tree hash alongside the SHA-256 (--no-tree-hash skips
+    // it), so receivers verify on all cores and can name corrupt chunks
+    bool tree_hash = true;
 };
 
 class Encryptor {
@@ -34,15 +61,25 @@ public:
     bool encryptAndUpload(const EncryptionConfig& config);
     
     // Individual steps
-    bool compressFile(const std::string& input_file, const std::string& output_file);
-    bool generateAESKey(const std::string& password, std::vector<uint8_t>& key, 
+    bool compressFile(const std::string& input_file, const std::string& output_file,
+                     size_t threads = 0, int level = 6);
+    bool generateAESKey(const std::string& password, const KdfParams& kdf, std::vector<uint8_t>& key, 
                        std::vector<uint8_t>& salt, std::vector<uint8_t>& iv);
     bool encryptFile(const std::string& input_file, const std::string& output_file,
-                    const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv);
+                    const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv,
+                    const std::string& mode = "cbc", size_t threads = 0);
+    // Compresses, encrypts ("cbc" or "gcm") and hashes in one pass, writing
+    // only config.encrypted_file; the output matches compressFile followed
+    // by encryptFile. With config.tree_hash, `tree` receives the tree hash
+    // of the same bytes; otherwise its leaves are left empty.
+    bool compressEncryptAndHash(const EncryptionConfig& config, const std::vector<uint8_t>& key,
+                                const std::vector<uint8_t>& iv, std::string& sha256_hash,
+                                HashUtils::TreeHash& tree);
     bool createKeyPackage(const std::vector<uint8_t>& key, const std::vector<uint8_t>& salt,
-                         const std::vector<uint8_t>& iv, const std::string& public_key_path,
-                         const std::string& output_file);
-    bool uploadToServer(const EncryptionConfig& config, const std::string& sha256_hash);
+                         const std::vector<uint8_t>& iv, const KdfParams& kdf,
+                         const RSAKey& public_key, const std::string& output_file);
+    bool uploadToServer(const EncryptionConfig& config, const std::string& sha256_hash,
+                       const std::string& tree_hash = "");
     
     // Utility functions
     std::string computeSHA256(const std::string& file_path);
@@ -50,7 +87,11 @@ public:
     
 private:
     void cleanupTempFiles(const EncryptionConfig& config);
+    bool resolveKdfParams(const EncryptionConfig& config, KdfParams& kdf);
     bool validateConfig(const EncryptionConfig& config);
+    
+    // Keeps the process-wide RSA key cache enabled while this encryptor is alive
+    RSAKey::KeyCacheScope rsa_key_cache_;
 };
 
 #endif // ENCRYPTOR_H
\ No newline at end of file
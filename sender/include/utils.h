@@ -5,15 +5,20 @@
 #include <vector>
 #include <chrono>
 
+#include "../../shared/include/file_view.h"
+
 namespace SenderUtils {
     
     // File operations
     bool fileExists(const std::string& path);
     bool readFile(const std::string& path, std::vector<uint8_t>& data);
+    // Maps the file instead of copying it; pipes and special files are buffered
+    bool readFile(const std::string& path, FileView& view);
     bool writeFile(const std::string& path, const std::vector<uint8_t>& data);
     size_t getFileSize(const std::string& path);
     
-    // String utilities
+    // String utilities (see shared/include/encoding.h); the decoders return
+    // an empty vector on invalid input
     std::string toHexString(const std::vector<uint8_t>& data);
     std::vector<uint8_t> fromHexString(const std::string& hex);
     std::string base64Encode(const std::vector<uint8_t>& data);
@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "../shared/include/encoding.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -27,19 +28,17 @@ bool fileExists(const std::string& path) {
 }
 
 bool readFile(const std::string& path, std::vector<uint8_t>& data) {
-    std::ifstream file(path, std::ios::binary);
-    if (!file) {
+    FileView view;
+    if (!readFile(path, view)) {
         return false;
     }
     
-    file.seekg(0, std::ios::end);
-    size_t size = file.tellg();
-    file.seekg(0, std::ios::beg);
-    
-    data.resize(size);
-    file.read(reinterpret_cast<char*>(data.data()), size);
-    
-    return !file.fail();
+    data.assign(view.data(), view.data() + view.size());
+    return true;
+}
+
+bool readFile(const std::string& path, FileView& view) {
+    return view.open(path);
 }
 
 bool writeFile(const std::string& path, const std::vector<uint8_t>& data) {
@@ -61,83 +60,19 @@ size_t getFileSize(const std::string& path) {
 }
 
 std::string toHexString(const std::vector<uint8_t>& data) {
-    std::stringstream ss;
-    ss << std::hex << std::setfill('0');
-    
-    for (uint8_t byte : data) {
-        ss << std::setw(2) << static_cast<int>(byte);
-    }
-    
-    return ss.str();
+    return Encoding::toHex(data);
 }
 
 std::vector<uint8_t> fromHexString(const std::string& hex) {
-    std::vector<uint8_t> bytes;
-    
-    for (size_t i = 0; i < hex.length(); i += 2) {
-        std::string byteString = hex.substr(i, 2);
-        uint8_t byte = static_cast<uint8_t>(std::stoi(byteString, nullptr, 16));
-        bytes.push_back(byte);
-    }
-    
-    return bytes;
+    return Encoding::fromHex(hex);
 }
 
 std::string base64Encode(const std::vector<uint8_t>& data) {
-    static const std::string base64_chars = 
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-        "abcdefghijklmnopqrstuvwxyz"
-        "0123456789+/";
-    
-    std::string encoded;
-    int val = 0, valb = -6;
-    
-    for (uint8_t c : data) {
-        val = (val << 8) + c;
-        valb += 8;
-        while (valb >= 0) {
-            encoded.push_back(base64_chars[(val >> valb) & 0x3F]);
-            valb -= 6;
-        }
-    }
-    
-    if (valb > -6) {
-        encoded.push_back(base64_chars[((val << 8) >> (valb + 8)) & 0x3F]);
-    }
-    
-    while (encoded.size() % 4) {
-        encoded.push_back('=');
-    }
-    
-    return encoded;
+    return Encoding::toBase64(data);
 }
 
 std::vector<uint8_t> base64Decode(const std::string& encoded) {
-    static const std::string base64_chars = 
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-        "abcdefghijklmnopqrstuvwxyz"
-        "0123456789+/";
-    
-    std::vector<uint8_t> decoded;
-    std::vector<int> T(256, -1);
-    
-    for (int i = 0; i < 64; i++) {
-        T[base64_chars[i]] = i;
-    }
-    
-    int val = 0, valb = -8;
-    
-    for (uint8_t c : encoded) {
-        if (T[c] == -1) break;
-        val = (val << 6) + T[c];
-        valb += 6;
-        if (valb >= 0) {
-            decoded.push_back(uint8_t((val >> valb) & 0xFF));
-            valb -= 8;
-        }
-    }
-    
-    return decoded;
+    return Encoding::fromBase64(encoded);
 }
 
 std::string getCurrentTimestamp() {
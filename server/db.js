@@ -39,6 +39,7 @@ function initializeDatabase() {
             encrypted_key_path TEXT NOT NULL,
             file_size INTEGER,
             sha256_hash TEXT,
+            tree_hash TEXT,
             release_time DATETIME NOT NULL,
             status TEXT DEFAULT 'pending',
             created_at DATETIME DEFAULT CURRENT_TIMESTAMP,
@@ -48,6 +49,12 @@ function initializeDatabase() {
         )
     `).run();
 
+    // Databases created before tree hashes were stored lack the column
+    const capsuleColumns = db.prepare('PRAGMA table_info(capsules)').all();
+    if (!capsuleColumns.some(column => column.name === 'tree_hash')) {
+        db.prepare('ALTER TABLE capsules ADD COLUMN tree_hash TEXT').run();
+    }
+
     // Create indexes for better performance
     db.prepare(`
         CREATE INDEX IF NOT EXISTS idx_capsules_release_time 
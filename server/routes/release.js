@@ -75,11 +75,20 @@ router.get('/download/file/:capsule_id', (req, res) => {
         res.setHeader('Content-Disposition', 
             `attachment; filename="${capsule.original_filename}.encrypted"`);
         
-        // Stream the file to the client
-        const fileStream = fs.createReadStream(capsule.encrypted_file_path);
-        fileStream.pipe(res);
+        // sendFile answers Range requests with 206 Partial Content, so
+        // receivers can fetch single chunks of seekable capsules
+        res.sendFile(path.resolve(capsule.encrypted_file_path), (err) => {
+            if (err && !res.headersSent) {
+                console.error('File download error:', err);
+                res.status(500).json({
+                    error: 'Internal server error',
+                    details: err.message
+                });
+            }
+        });
 
-        console.log(`File downloaded: ${capsule.encrypted_file_path} for capsule: ${capsule_id}`);
+        const range = req.headers.range ? ` (range ${req.headers.range})` : '';
+        console.log(`File downloaded: ${capsule.encrypted_file_path}${range} for capsule: ${capsule_id}`);
 
     } catch (error) {
         console.error('File download error:', error);
@@ -152,7 +161,7 @@ router.get('/metadata/:capsule_id', (req, res) => {
         const stmt = db.prepare(`
             SELECT 
                 capsule_id, sender_info, receiver_id, original_filename,
-                file_size, sha256_hash, release_time, status,
+                file_size, sha256_hash, tree_hash, release_time, status,
                 created_at, delivered_at
             FROM capsules 
             WHERE capsule_id = ?
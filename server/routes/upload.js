@@ -43,6 +43,7 @@ router.post('/', upload.fields([
             original_filename,
             release_time,
             sha256_hash,
+            tree_hash,
             file_size
         } = req.body;
 
@@ -105,8 +106,8 @@ router.post('/', upload.fields([
             INSERT INTO capsules (
                 capsule_id, sender_info, receiver_id, original_filename,
                 encrypted_file_path, encrypted_key_path, file_size,
-                sha256_hash, release_time, created_at
-            ) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+                sha256_hash, tree_hash, release_time, created_at
+            ) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
         `);
 
         stmt.run(
@@ -118,6 +119,7 @@ router.post('/', upload.fields([
             encrypted_key_path,
             file_size || 0,
             sha256_hash || '',
+            tree_hash || null,
             release_time,
             created_at
         );
@@ -166,7 +168,7 @@ router.get('/status/:capsule_id', (req, res) => {
         const stmt = db.prepare(`
             SELECT 
                 capsule_id, sender_info, receiver_id, original_filename,
-                file_size, sha256_hash, release_time, status,
+                file_size, sha256_hash, tree_hash, release_time, status,
                 created_at, delivered_at
             FROM capsules 
             WHERE capsule_id = ?
@@ -1,16 +1,419 @@
 #include "aes_cbc.h"
+#include "thread_pool.h"
+#include "file_view.h"
 #include <cryptopp/aes.h>
 #include <cryptopp/modes.h>
-#include <cryptopp/filters.h>
 #include <cryptopp/pwdbased.h>
 #include <cryptopp/sha.h>
 #include <cryptopp/osrng.h>
+#include <cryptopp/secblock.h>
+#include <cryptopp/misc.h>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <mutex>
 
 using namespace CryptoPP;
 
-AESCrypto::AESCrypto() {
+namespace {
+
+// Working set of encryptFile/decryptFile, a multiple of the AES block size
+const size_t kFileChunkSize = 4 << 20;
+
+// Smallest ciphertext range handed to a decryption worker
+const size_t kMinDecryptRange = 64 << 10;
+
+void decryptRange(const std::vector<uint8_t>& key, const uint8_t* iv,
+                  const uint8_t* input, uint8_t* output, size_t size) {
+    CBC_Mode<AES>::Decryption decryptor;
+    decryptor.SetKeyWithIV(key.data(), key.size(), iv, AES::BLOCKSIZE);
+    decryptor.ProcessData(output, input, size);
+}
+
+// CBC decryption of a block needs only that block and the ciphertext block
+// before it, so `size` bytes split into ranges that decrypt independently,
+// each with the preceding ciphertext block as its IV. Those IVs are copied
+// into range_ivs first because in-place decryption of one range overwrites
+// the next range's IV. Without a pool the data is decrypted before
+// returning; otherwise the caller must wait on every returned future
+// before touching the buffers.
+std::vector<std::future<void>> submitDecrypt(ThreadPool* pool, const std::vector<uint8_t>& key,
+                                             const uint8_t* iv, const uint8_t* input,
+                                             uint8_t* output, size_t size,
+                                             std::vector<uint8_t>& range_ivs) {
+    std::vector<std::future<void>> ranges;
+    if (!pool) {
+        decryptRange(key, iv, input, output, size);
+        return ranges;
+    }
+    
+    const size_t blocks = size / AES::BLOCKSIZE;
+    const size_t range_count = std::max<size_t>(1, std::min(pool->size(), size / kMinDecryptRange));
+    range_ivs.resize(range_count * AES::BLOCKSIZE);
+    std::vector<size_t> starts(range_count + 1, size);
+    for (size_t r = 0; r < range_count; r++) {
+        starts[r] = blocks * r / range_count * AES::BLOCKSIZE;
+        const uint8_t* range_iv = r == 0 ? iv : input + starts[r] - AES::BLOCKSIZE;
+        std::memcpy(range_ivs.data() + r * AES::BLOCKSIZE, range_iv, AES::BLOCKSIZE);
+    }
+    
+    ranges.reserve(range_count);
+    for (size_t r = 0; r < range_count; r++) {
+        const uint8_t* range_iv = range_ivs.data() + r * AES::BLOCKSIZE;
+        const uint8_t* range_input = input + starts[r];
+        uint8_t* range_output = output + starts[r];
+        size_t range_size = starts[r + 1] - starts[r];
+        ranges.push_back(pool->submit([&key, range_iv, range_input, range_output, range_size]() {
+            decryptRange(key, range_iv, range_input, range_output, range_size);
+        }));
+    }
+    return ranges;
+}
+
+// Waits for every range before rethrowing a failure, so no worker is left
+// writing into a buffer the caller is about to release
+void waitForRanges(std::vector<std::future<void>>& ranges) {
+    for (auto& range : ranges) {
+        range.wait();
+    }
+    for (auto& range : ranges) {
+        range.get();
+    }
+}
+
+// PBKDF2 results, most recently used first. SecByteBlock zeroizes both the
+// identity and the key when an entry is dropped.
+struct CachedKey {
+    SecByteBlock id;
+    SecByteBlock key;
+};
+
+std::mutex key_cache_mutex;
+std::list<CachedKey> key_cache;
+size_t key_cache_capacity = 0;
+size_t key_cache_scopes = 0;
+
+// SHA-256(password) | salt | iterations | key size
+SecByteBlock keyCacheId(const std::string& password, const std::vector<uint8_t>& salt,
+                        size_t key_size, int iterations) {
+    SecByteBlock id(SHA256::DIGESTSIZE + salt.size() + 8);
+    SHA256().CalculateDigest(id.data(), reinterpret_cast<const byte*>(password.data()), password.size());
+    std::copy(salt.begin(), salt.end(), id.data() + SHA256::DIGESTSIZE);
+    uint8_t* tail = id.data() + SHA256::DIGESTSIZE + salt.size();
+    for (int i = 0; i < 4; i++) {
+        tail[i] = static_cast<uint8_t>(static_cast<uint32_t>(iterations) >> (8 * i));
+        tail[4 + i] = static_cast<uint8_t>(static_cast<uint32_t>(key_size) >> (8 * i));
+    }
+    return id;
+}
+
+} // namespace
+
+// Keyed CBC ciphers reused across encryptData/decryptData calls. Each
+// direction is keyed on first use and after a key change; otherwise only
+// the IV is reset.
+struct AESCrypto::CipherContext {
+    SecByteBlock key;
+    CBC_Mode<AES>::Encryption encryptor;
+    CBC_Mode<AES>::Decryption decryptor;
+    bool encryptor_keyed = false;
+    bool decryptor_keyed = false;
+    
+    void useKey(const std::vector<uint8_t>& new_key) {
+        if (key.size() != new_key.size() || !VerifyBufsEqual(key.data(), new_key.data(), key.size())) {
+            key.Assign(new_key.data(), new_key.size());
+            encryptor_keyed = false;
+            decryptor_keyed = false;
+        }
+    }
+    
+    CBC_Mode<AES>::Encryption& encryption(const std::vector<uint8_t>& new_key,
+                                          const std::vector<uint8_t>& iv) {
+        useKey(new_key);
+        if (encryptor_keyed) {
+            encryptor.Resynchronize(iv.data(), static_cast<int>(iv.size()));
+        } else {
+            encryptor.SetKeyWithIV(key.data(), key.size(), iv.data(), iv.size());
+            encryptor_keyed = true;
+        }
+        return encryptor;
+    }
+    
+    CBC_Mode<AES>::Decryption& decryption(const std::vector<uint8_t>& new_key,
+                                          const std::vector<uint8_t>& iv) {
+        useKey(new_key);
+        if (decryptor_keyed) {
+            decryptor.Resynchronize(iv.data(), static_cast<int>(iv.size()));
+        } else {
+            decryptor.SetKeyWithIV(key.data(), key.size(), iv.data(), iv.size());
+            decryptor_keyed = true;
+        }
+        return decryptor;
+    }
+    
+    // Workers for in-memory decryption, kept between calls so batches of
+    // large inputs do not start and join a pool each time. Rebuilt only
+    // when a different thread count is asked for.
+    std::unique_ptr<ThreadPool> pool;
+    
+    ThreadPool* workers(size_t threads) {
+        if (!pool || pool->size() != threads) {
+            pool.reset(new ThreadPool(threads));
+        }
+        return pool.get();
+    }
+};
+
+// Encrypts whole blocks as they arrive and holds back the partial block at
+// the end, which finish() pads
+class AESCrypto::CBCStreamEncryptor : public CapsuleEncryptor {
+public:
+    CBCStreamEncryptor(const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv)
+        : tail_size_(0), finished_(false) {
+        encryptor_.SetKeyWithIV(key.data(), key.size(), iv.data(), iv.size());
+    }
+    
+    bool update(const uint8_t* data, size_t size, std::vector<uint8_t>& output) override {
+        if (finished_) {
+            return false;
+        }
+        if (size == 0) {
+            return true;
+        }
+        
+        size_t ready = (tail_size_ + size) / AES::BLOCKSIZE * AES::BLOCKSIZE;
+        if (ready == 0) {
+            std::memcpy(tail_ + tail_size_, data, size);
+            tail_size_ += size;
+            return true;
+        }
+        
+        size_t start = output.size();
+        output.resize(start + ready);
+        uint8_t* out = output.data() + start;
+        if (tail_size_ > 0) {
+            size_t fill = AES::BLOCKSIZE - tail_size_;
+            std::memcpy(tail_ + tail_size_, data, fill);
+            encryptor_.ProcessData(out, tail_, AES::BLOCKSIZE);
+            out += AES::BLOCKSIZE;
+            data += fill;
+            size -= fill;
+            ready -= AES::BLOCKSIZE;
+        }
+        encryptor_.ProcessData(out, data, ready);
+        
+        tail_size_ = size - ready;
+        std::memcpy(tail_, data + ready, tail_size_);
+        return true;
+    }
+    
+    bool finish(std::vector<uint8_t>& output) override {
+        if (finished_) {
+            return false;
+        }
+        finished_ = true;
+        
+        addPadding(tail_, tail_size_);
+        size_t start = output.size();
+        output.resize(start + AES::BLOCKSIZE);
+        encryptor_.ProcessData(output.data() + start, tail_, AES::BLOCKSIZE);
+        return true;
+    }
+
+private:
+    CBC_Mode<AES>::Encryption encryptor_;
+    uint8_t tail_[AES::BLOCKSIZE];
+    size_t tail_size_;
+    bool finished_;
+};
+
+// Always holds back the last whole block, which may carry the padding,
+// until finish() shows that no more ciphertext follows. With a pool, pieces
+// of at least two kMinDecryptRange ranges are split across its workers
+// (see submitDecrypt) and the cipher is resynchronized after them.
+class AESCrypto::CBCStreamDecryptor : public CapsuleDecryptor {
+public:
+    CBCStreamDecryptor(const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv,
+                       std::unique_ptr<ThreadPool> pool)
+        : key_(key), tail_size_(0), finished_(false), pool_(std::move(pool)) {
+        decryptor_.SetKeyWithIV(key.data(), key.size(), iv.data(), iv.size());
+        std::memcpy(chain_iv_, iv.data(), AES::BLOCKSIZE);
+    }
+    
+    bool update(const uint8_t* data, size_t size, std::vector<uint8_t>& output) override {
+        if (finished_) {
+            return false;
+        }
+        if (size == 0) {
+            return true;
+        }
+        
+        // Everything but the last 1-16 bytes is safe to decrypt
+        size_t total = tail_size_ + size;
+        size_t ready = (total - 1) / AES::BLOCKSIZE * AES::BLOCKSIZE;
+        if (ready == 0) {
+            std::memcpy(tail_ + tail_size_, data, size);
+            tail_size_ += size;
+            return true;
+        }
+        
+        size_t start = output.size();
+        output.resize(start + ready);
+        uint8_t* out = output.data() + start;
+        if (tail_size_ > 0) {
+            size_t fill = AES::BLOCKSIZE - tail_size_;
+            std::memcpy(tail_ + tail_size_, data, fill);
+            decryptor_.ProcessData(out, tail_, AES::BLOCKSIZE);
+            std::memcpy(chain_iv_, tail_, AES::BLOCKSIZE);
+            out += AES::BLOCKSIZE;
+            data += fill;
+            size -= fill;
+            ready -= AES::BLOCKSIZE;
+        }
+        if (pool_ && ready >= 2 * kMinDecryptRange) {
+            std::vector<std::future<void>> ranges = submitDecrypt(pool_.get(), key_, chain_iv_, data, out,
+                                                                  ready, range_ivs_);
+            waitForRanges(ranges);
+            decryptor_.Resynchronize(data + ready - AES::BLOCKSIZE, AES::BLOCKSIZE);
+        } else {
+            decryptor_.ProcessData(out, data, ready);
+        }
+        if (ready > 0) {
+            std::memcpy(chain_iv_, data + ready - AES::BLOCKSIZE, AES::BLOCKSIZE);
+        }
+        
+        tail_size_ = size - ready;
+        std::memcpy(tail_, data + ready, tail_size_);
+        return true;
+    }
+    
+    bool finish(std::vector<uint8_t>& output) override {
+        if (finished_) {
+            return false;
+        }
+        finished_ = true;
+        
+        if (tail_size_ != AES::BLOCKSIZE) {
+            std::cerr << "Encrypted data is not a whole number of blocks" << std::endl;
+            return false;
+        }
+        uint8_t block[AES::BLOCKSIZE];
+        decryptor_.ProcessData(block, tail_, AES::BLOCKSIZE);
+        size_t padding = 0;
+        if (!paddingLength(block, AES::BLOCKSIZE, padding)) {
+            std::cerr << "Invalid padding (wrong key or corrupted file)" << std::endl;
+            return false;
+        }
+        output.insert(output.end(), block, block + AES::BLOCKSIZE - padding);
+        return true;
+    }
+
+private:
+    std::vector<uint8_t> key_;
+    CBC_Mode<AES>::Decryption decryptor_;
+    // Last ciphertext block decrypted, the IV of whatever follows
+    uint8_t chain_iv_[AES::BLOCKSIZE];
+    uint8_t tail_[AES::BLOCKSIZE];
+    size_t tail_size_;
+    bool finished_;
+    std::vector<uint8_t> range_ivs_;
+    std::unique_ptr<ThreadPool> pool_;
+};
+
+// Buffers the first kGCMPrefixSize bytes to tell GCM capsules from CBC ones,
+// then hands everything to the decryptor for that mode
+class AESCrypto::DetectingDecryptor : public CapsuleDecryptor {
+public:
+    DetectingDecryptor(const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv, size_t threads)
+        : key_(key), iv_(iv), threads_(threads), prefix_size_(0) {}
+    
+    bool update(const uint8_t* data, size_t size, std::vector<uint8_t>& output) override {
+        if (!mode_) {
+            size_t take = std::min(size, kGCMPrefixSize - prefix_size_);
+            std::memcpy(prefix_ + prefix_size_, data, take);
+            prefix_size_ += take;
+            data += take;
+            size -= take;
+            if (prefix_size_ < kGCMPrefixSize) {
+                return true;
+            }
+            if (!detect(output)) {
+                return false;
+            }
+        }
+        return mode_->update(data, size, output);
+    }
+    
+    bool finish(std::vector<uint8_t>& output) override {
+        // Shorter than the prefix: only a (corrupt) CBC capsule could be
+        if (!mode_ && !detect(output)) {
+            return false;
+        }
+        return mode_->finish(output);
+    }
+
+private:
+    bool detect(std::vector<uint8_t>& output) {
+        if (prefix_size_ == kGCMPrefixSize && isGCMPrefix(prefix_)) {
+            mode_ = createGCMDecryptor(key_, threads_);
+        } else {
+            mode_.reset(new CBCStreamDecryptor(key_, iv_, createPool(threads_, SIZE_MAX)));
+        }
+        return mode_->update(prefix_, prefix_size_, output);
+    }
+    
+    std::vector<uint8_t> key_;
+    std::vector<uint8_t> iv_;
+    size_t threads_;
+    uint8_t prefix_[kGCMPrefixSize];
+    size_t prefix_size_;
+    std::unique_ptr<CapsuleDecryptor> mode_;
+};
+
+std::unique_ptr<CapsuleEncryptor> AESCrypto::createEncryptor(const std::string& mode,
+                                                             const std::vector<uint8_t>& key,
+                                                             const std::vector<uint8_t>& iv,
+                                                             size_t threads) {
+    try {
+        AESCrypto aes;
+        if (!aes.checkKeyAndIV(key, iv)) {
+            return nullptr;
+        }
+        if (mode == "gcm") {
+            return createGCMEncryptor(key, iv, threads);
+        }
+        if (mode == "cbc") {
+            return std::unique_ptr<CapsuleEncryptor>(new CBCStreamEncryptor(key, iv));
+        }
+        std::cerr << "Unknown cipher mode: " << mode << std::endl;
+        return nullptr;
+    } catch (const std::exception& e) {
+        std::cerr << "Encryption error: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+std::unique_ptr<CapsuleDecryptor> AESCrypto::createDecryptor(const std::vector<uint8_t>& key,
+                                                             const std::vector<uint8_t>& iv,
+                                                             size_t threads) {
+    try {
+        AESCrypto aes;
+        if (!aes.checkKeyAndIV(key, iv)) {
+            return nullptr;
+        }
+        return std::unique_ptr<CapsuleDecryptor>(new DetectingDecryptor(key, iv, threads));
+    } catch (const std::exception& e) {
+        std::cerr << "Decryption error: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+AESCrypto::AESCrypto() : context_(new CipherContext()) {
 }
 
 AESCrypto::~AESCrypto() {
@@ -19,40 +422,57 @@ AESCrypto::~AESCrypto() {
 bool AESCrypto::encryptFile(const std::string& input_file, const std::string& output_file,
                            const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
     try {
-        // Read input file
-        std::ifstream in_file(input_file, std::ios::binary);
-        if (!in_file) {
-            std::cerr << "Cannot open input file: " << input_file << std::endl;
+        if (!checkKeyAndIV(key, iv)) {
             return false;
         }
         
-        std::vector<uint8_t> input_data((std::istreambuf_iterator<char>(in_file)),
-                                      std::istreambuf_iterator<char>());
-        in_file.close();
-        
-        if (input_data.empty()) {
-            std::cerr << "Input file is empty: " << input_file << std::endl;
+        FileView input;
+        if (!input.open(input_file)) {
             return false;
         }
-        
-        // Encrypt data
-        std::vector<uint8_t> encrypted_data;
-        if (!encryptData(input_data, encrypted_data, key, iv)) {
-            std::cerr << "Encryption failed" << std::endl;
+        if (input.empty()) {
+            std::cerr << "Input file is empty: " << input_file << std::endl;
             return false;
         }
         
-        // Write encrypted file
         std::ofstream out_file(output_file, std::ios::binary);
         if (!out_file) {
             std::cerr << "Cannot create output file: " << output_file << std::endl;
             return false;
         }
         
-        out_file.write(reinterpret_cast<const char*>(encrypted_data.data()), 
-                      encrypted_data.size());
-        out_file.close();
+        CBC_Mode<AES>::Encryption& encryptor = context_->encryption(key, iv);
+        
+        // Encrypt straight out of the file view one chunk at a time; only the
+        // short last chunk is copied, to pad it, so the output matches
+        // encryptData on the whole file
+        std::vector<uint8_t> buffer(kFileChunkSize + AES::BLOCKSIZE);
+        size_t offset = 0;
+        
+        while (true) {
+            size_t chunk_bytes = std::min(kFileChunkSize, input.size() - offset);
+            bool last_chunk = chunk_bytes < kFileChunkSize;
+            if (last_chunk) {
+                std::memcpy(buffer.data(), input.data() + offset, chunk_bytes);
+                chunk_bytes += addPadding(buffer.data(), chunk_bytes);
+                encryptor.ProcessData(buffer.data(), buffer.data(), chunk_bytes);
+            } else {
+                encryptor.ProcessData(buffer.data(), input.data() + offset, chunk_bytes);
+                offset += chunk_bytes;
+            }
+            
+            out_file.write(reinterpret_cast<const char*>(buffer.data()), chunk_bytes);
+            if (out_file.fail()) {
+                std::cerr << "Failed to write encrypted file" << std::endl;
+                return false;
+            }
+            
+            if (last_chunk) {
+                break;
+            }
+        }
         
+        out_file.close();
         if (out_file.fail()) {
             std::cerr << "Failed to write encrypted file" << std::endl;
             return false;
@@ -68,43 +488,116 @@ bool AESCrypto::encryptFile(const std::string& input_file, const std::string& ou
 }
 
 bool AESCrypto::decryptFile(const std::string& input_file, const std::string& output_file,
-                           const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
+                           const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv,
+                           size_t threads) {
+    bool output_created = false;
     try {
-        // Read encrypted file
-        std::ifstream in_file(input_file, std::ios::binary);
+        if (!checkKeyAndIV(key, iv)) {
+            return false;
+        }
+        
+        std::ifstream in_file(input_file, std::ios::binary | std::ios::ate);
         if (!in_file) {
             std::cerr << "Cannot open input file: " << input_file << std::endl;
             return false;
         }
         
-        std::vector<uint8_t> encrypted_data((std::istreambuf_iterator<char>(in_file)),
-                                          std::istreambuf_iterator<char>());
-        in_file.close();
+        uint64_t remaining = static_cast<uint64_t>(in_file.tellg());
+        in_file.seekg(0, std::ios::beg);
         
-        if (encrypted_data.empty()) {
+        if (remaining == 0) {
             std::cerr << "Encrypted file is empty: " << input_file << std::endl;
             return false;
         }
-        
-        // Decrypt data
-        std::vector<uint8_t> decrypted_data;
-        if (!decryptData(encrypted_data, decrypted_data, key, iv)) {
-            std::cerr << "Decryption failed" << std::endl;
+        if (remaining % AES::BLOCKSIZE != 0) {
+            std::cerr << "Encrypted file is not a whole number of AES blocks: " << input_file << std::endl;
             return false;
         }
         
-        // Write decrypted file
         std::ofstream out_file(output_file, std::ios::binary);
         if (!out_file) {
             std::cerr << "Cannot create output file: " << output_file << std::endl;
             return false;
         }
+        output_created = true;
         
-        out_file.write(reinterpret_cast<const char*>(decrypted_data.data()), 
-                      decrypted_data.size());
-        out_file.close();
+        // Nothing is left behind on failure: the final padding is only
+        // checked after every earlier chunk has been written
+        auto fail = [&](const std::string& message) {
+            std::cerr << message << std::endl;
+            out_file.close();
+            std::remove(output_file.c_str());
+            return false;
+        };
+        
+        // The chunk size is a multiple of the block size, so the padded final
+        // block always arrives whole in the last chunk. Chunks alternate
+        // between two buffers: one is decrypted while the next is read into
+        // the other. The pool is declared last so its workers are joined
+        // before the buffers are freed.
+        std::vector<uint8_t> buffer(kFileChunkSize);
+        std::vector<uint8_t> next_buffer;
+        std::vector<uint8_t> range_ivs;
+        std::unique_ptr<ThreadPool> pool = createPool(threads, static_cast<size_t>(
+            std::min<uint64_t>(remaining, kFileChunkSize) / kMinDecryptRange));
+        if (pool) {
+            next_buffer.resize(kFileChunkSize);
+        }
+        
+        // IV of the next chunk: the last ciphertext block before it
+        uint8_t chain_iv[AES::BLOCKSIZE];
+        std::copy(iv.begin(), iv.end(), chain_iv);
+        
+        size_t chunk_bytes = static_cast<size_t>(std::min<uint64_t>(remaining, kFileChunkSize));
+        if (!in_file.read(reinterpret_cast<char*>(buffer.data()), chunk_bytes)) {
+            return fail("Failed to read encrypted file: " + input_file);
+        }
+        remaining -= chunk_bytes;
         
+        while (chunk_bytes > 0) {
+            uint8_t next_iv[AES::BLOCKSIZE];
+            std::memcpy(next_iv, buffer.data() + chunk_bytes - AES::BLOCKSIZE, AES::BLOCKSIZE);
+            std::vector<std::future<void>> ranges = submitDecrypt(pool.get(), key, chain_iv,
+                                                                  buffer.data(), buffer.data(),
+                                                                  chunk_bytes, range_ivs);
+            
+            size_t next_bytes = static_cast<size_t>(std::min<uint64_t>(remaining, kFileChunkSize));
+            bool read_ok = true;
+            if (next_bytes > 0) {
+                if (!pool) {
+                    next_buffer.resize(kFileChunkSize);
+                }
+                read_ok = static_cast<bool>(in_file.read(reinterpret_cast<char*>(next_buffer.data()),
+                                                         next_bytes));
+            }
+            waitForRanges(ranges);
+            if (!read_ok) {
+                return fail("Failed to read encrypted file: " + input_file);
+            }
+            remaining -= next_bytes;
+            std::memcpy(chain_iv, next_iv, AES::BLOCKSIZE);
+            
+            size_t plain_bytes = chunk_bytes;
+            if (next_bytes == 0) {
+                size_t padding = 0;
+                if (!paddingLength(buffer.data(), chunk_bytes, padding)) {
+                    return fail("Invalid padding (wrong key or corrupted file)");
+                }
+                plain_bytes -= padding;
+            }
+            
+            out_file.write(reinterpret_cast<const char*>(buffer.data()), plain_bytes);
+            if (out_file.fail()) {
+                return fail("Failed to write decrypted file");
+            }
+            
+            buffer.swap(next_buffer);
+            chunk_bytes = next_bytes;
+        }
+        
+        out_file.close();
         if (out_file.fail()) {
+            std::remove(output_file.c_str());
             std::cerr << "Failed to write decrypted file" << std::endl;
             return false;
         }
@@ -114,75 +607,137 @@ bool AESCrypto::decryptFile(const std::string& input_file, const std::string& ou
         
     } catch (const std::exception& e) {
         std::cerr << "Decryption error: " << e.what() << std::endl;
+        if (output_created) {
+            std::remove(output_file.c_str());
+        }
         return false;
     }
 }
 
 bool AESCrypto::encryptData(const std::vector<uint8_t>& input, std::vector<uint8_t>& output,
                            const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
+    output.resize(paddedSize(input.size()));
+    size_t output_size = 0;
+    if (!encryptData(input.data(), input.size(), output.data(), output.size(), output_size, key, iv)) {
+        output.clear();
+        return false;
+    }
+    return true;
+}
+
+bool AESCrypto::decryptData(const std::vector<uint8_t>& input, std::vector<uint8_t>& output,
+                           const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv,
+                           size_t threads) {
     try {
-        // Validate key size
-        if (key.size() != 16 && key.size() != 24 && key.size() != 32) {
-            std::cerr << "Invalid AES key size: " << key.size() << std::endl;
+        if (!checkKeyAndIV(key, iv)) {
             return false;
         }
         
-        if (iv.size() != AES::BLOCKSIZE) {
-            std::cerr << "Invalid IV size: " << iv.size() << std::endl;
+        if (input.empty() || input.size() % AES::BLOCKSIZE != 0) {
+            std::cerr << "Invalid ciphertext size: " << input.size() << std::endl;
             return false;
         }
         
-        // Prepare data with padding
-        std::vector<uint8_t> padded_data = input;
-        addPadding(padded_data);
+        output.resize(input.size());
+        if (threads == 0) {
+            threads = ThreadPool::defaultThreadCount();
+        }
+        if (std::min(threads, input.size() / kMinDecryptRange) <= 1) {
+            size_t output_size = 0;
+            bool decrypted = decryptData(input.data(), input.size(), output.data(), output.size(),
+                                         output_size, key, iv);
+            output.resize(decrypted ? output_size : 0);
+            return decrypted;
+        }
         
-        // Encrypt using Crypto++
-        CBC_Mode<AES>::Encryption encryptor;
-        encryptor.SetKeyWithIV(key.data(), key.size(), iv.data(), iv.size());
+        // Large inputs are split across workers, each with its own cipher
+        std::vector<uint8_t> range_ivs;
+        std::vector<std::future<void>> ranges = submitDecrypt(context_->workers(threads), key, iv.data(),
+                                                              input.data(), output.data(),
+                                                              input.size(), range_ivs);
+        waitForRanges(ranges);
         
-        output.resize(padded_data.size());
-        ArraySource as(padded_data.data(), padded_data.size(), true,
-            new StreamTransformationFilter(encryptor,
-                new ArraySink(output.data(), output.size())
-            )
-        );
+        // Remove padding
+        if (!removePadding(output)) {
+            std::cerr << "Invalid padding (wrong key or corrupted data)" << std::endl;
+            output.clear();
+            return false;
+        }
         
         return true;
         
     } catch (const std::exception& e) {
-        std::cerr << "Encryption error: " << e.what() << std::endl;
+        std::cerr << "Decryption error: " << e.what() << std::endl;
         return false;
     }
 }
 
-bool AESCrypto::decryptData(const std::vector<uint8_t>& input, std::vector<uint8_t>& output,
+bool AESCrypto::encryptData(const uint8_t* input, size_t input_size,
+                           uint8_t* output, size_t output_capacity, size_t& output_size,
                            const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
     try {
-        // Validate key size
-        if (key.size() != 16 && key.size() != 24 && key.size() != 32) {
-            std::cerr << "Invalid AES key size: " << key.size() << std::endl;
+        output_size = 0;
+        if (!checkKeyAndIV(key, iv)) {
             return false;
         }
         
-        if (iv.size() != AES::BLOCKSIZE) {
-            std::cerr << "Invalid IV size: " << iv.size() << std::endl;
+        const size_t padded_size = paddedSize(input_size);
+        if (output_capacity < padded_size) {
+            std::cerr << "Output buffer too small: " << output_capacity << " < " << padded_size << std::endl;
             return false;
         }
         
-        // Decrypt using Crypto++
-        CBC_Mode<AES>::Decryption decryptor;
-        decryptor.SetKeyWithIV(key.data(), key.size(), iv.data(), iv.size());
+        // Whole blocks go straight from input to output; only the final,
+        // padded block is assembled on the stack
+        const size_t full_size = input_size - input_size % AES::BLOCKSIZE;
+        uint8_t last_block[AES::BLOCKSIZE];
+        if (input_size > full_size) {
+            std::memcpy(last_block, input + full_size, input_size - full_size);
+        }
+        addPadding(last_block, input_size - full_size);
         
-        output.resize(input.size());
-        ArraySource as(input.data(), input.size(), true,
-            new StreamTransformationFilter(decryptor,
-                new ArraySink(output.data(), output.size())
-            )
-        );
+        CBC_Mode<AES>::Encryption& encryptor = context_->encryption(key, iv);
+        if (full_size > 0) {
+            encryptor.ProcessData(output, input, full_size);
+        }
+        encryptor.ProcessData(output + full_size, last_block, AES::BLOCKSIZE);
         
-        // Remove padding
-        removePadding(output);
+        output_size = padded_size;
+        return true;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Encryption error: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool AESCrypto::decryptData(const uint8_t* input, size_t input_size,
+                           uint8_t* output, size_t output_capacity, size_t& output_size,
+                           const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
+    try {
+        output_size = 0;
+        if (!checkKeyAndIV(key, iv)) {
+            return false;
+        }
+        
+        if (input_size == 0 || input_size % AES::BLOCKSIZE != 0) {
+            std::cerr << "Invalid ciphertext size: " << input_size << std::endl;
+            return false;
+        }
+        if (output_capacity < input_size) {
+            std::cerr << "Output buffer too small: " << output_capacity << " < " << input_size << std::endl;
+            return false;
+        }
+        
+        context_->decryption(key, iv).ProcessData(output, input, input_size);
         
+        size_t padding = 0;
+        if (!paddingLength(output, input_size, padding)) {
+            std::cerr << "Invalid padding (wrong key or corrupted data)" << std::endl;
+            return false;
+        }
+        
+        output_size = input_size - padding;
         return true;
         
     } catch (const std::exception& e) {
@@ -191,10 +746,28 @@ bool AESCrypto::decryptData(const std::vector<uint8_t>& input, std::vector<uint8
     }
 }
 
+size_t AESCrypto::paddedSize(size_t plain_size) {
+    return plain_size - plain_size % AES::BLOCKSIZE + AES::BLOCKSIZE;
+}
+
 std::vector<uint8_t> AESCrypto::deriveKeyPBKDF2(const std::string& password,
                                                const std::vector<uint8_t>& salt,
                                                size_t key_size, int iterations) {
     try {
+        SecByteBlock id;
+        {
+            std::lock_guard<std::mutex> lock(key_cache_mutex);
+            if (key_cache_capacity > 0) {
+                id = keyCacheId(password, salt, key_size, iterations);
+                for (auto it = key_cache.begin(); it != key_cache.end(); ++it) {
+                    if (it->id.size() == id.size() && VerifyBufsEqual(it->id.data(), id.data(), id.size())) {
+                        key_cache.splice(key_cache.begin(), key_cache, it);
+                        return std::vector<uint8_t>(it->key.begin(), it->key.end());
+                    }
+                }
+            }
+        }
+        
         std::vector<uint8_t> key(key_size);
         
         PKCS5_PBKDF2_HMAC<SHA256> pbkdf;
@@ -202,6 +775,16 @@ std::vector<uint8_t> AESCrypto::deriveKeyPBKDF2(const std::string& password,
                        reinterpret_cast<const byte*>(password.data()), password.size(),
                        salt.data(), salt.size(), iterations);
         
+        if (!id.empty()) {
+            std::lock_guard<std::mutex> lock(key_cache_mutex);
+            if (key_cache_capacity > 0) {
+                key_cache.push_front(CachedKey{id, SecByteBlock(key.data(), key.size())});
+                while (key_cache.size() > key_cache_capacity) {
+                    key_cache.pop_back();
+                }
+            }
+        }
+        
         return key;
         
     } catch (const std::exception& e) {
@@ -210,6 +793,36 @@ std::vector<uint8_t> AESCrypto::deriveKeyPBKDF2(const std::string& password,
     }
 }
 
+void AESCrypto::setKeyCacheCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(key_cache_mutex);
+    key_cache_capacity = capacity;
+    while (key_cache.size() > key_cache_capacity) {
+        key_cache.pop_back();
+    }
+}
+
+void AESCrypto::clearKeyCache() {
+    std::lock_guard<std::mutex> lock(key_cache_mutex);
+    key_cache.clear();
+}
+
+AESCrypto::KeyCacheScope::KeyCacheScope(size_t capacity) : capacity_(capacity) {
+    std::lock_guard<std::mutex> lock(key_cache_mutex);
+    key_cache_scopes++;
+    key_cache_capacity = std::max(key_cache_capacity, capacity);
+}
+
+AESCrypto::KeyCacheScope::KeyCacheScope(const KeyCacheScope& other) : KeyCacheScope(other.capacity_) {
+}
+
+AESCrypto::KeyCacheScope::~KeyCacheScope() {
+    std::lock_guard<std::mutex> lock(key_cache_mutex);
+    if (--key_cache_scopes == 0) {
+        key_cache.clear();
+        key_cache_capacity = 0;
+    }
+}
+
 std::vector<uint8_t> AESCrypto::generateRandomIV() {
     AutoSeededRandomPool rng;
     std::vector<uint8_t> iv(AES::BLOCKSIZE);
@@ -232,22 +845,63 @@ bool AESCrypto::validateKey(const std::vector<uint8_t>& key) {
     return (key.size() == 16 || key.size() == 24 || key.size() == 32);
 }
 
-void AESCrypto::addPadding(std::vector<uint8_t>& data) {
+std::unique_ptr<ThreadPool> AESCrypto::createPool(size_t threads, size_t work_items) {
+    if (threads == 0) {
+        threads = ThreadPool::defaultThreadCount();
+    }
+    threads = std::min(threads, work_items);
+    if (threads <= 1) {
+        return nullptr;
+    }
+    return std::unique_ptr<ThreadPool>(new ThreadPool(threads));
+}
+
+bool AESCrypto::checkKeyAndIV(const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
+    if (!validateKey(key)) {
+        std::cerr << "Invalid AES key size: " << key.size() << std::endl;
+        return false;
+    }
+    if (iv.size() != AES::BLOCKSIZE) {
+        std::cerr << "Invalid IV size: " << iv.size() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+size_t AESCrypto::addPadding(uint8_t* data, size_t size) {
+    // PKCS#7: 1-16 bytes each holding the pad length; data must have room
+    // for a full extra block
     size_t block_size = AES::BLOCKSIZE;
-    size_t padding = block_size - (data.size() % block_size);
+    size_t padding = block_size - (size % block_size);
     
     for (size_t i = 0; i < padding; i++) {
-        data.push_back(static_cast<uint8_t>(padding));
+        data[size + i] = static_cast<uint8_t>(padding);
     }
+    return padding;
 }
 
-void AESCrypto::removePadding(std::vector<uint8_t>& data) {
-    if (data.empty()) return;
+bool AESCrypto::paddingLength(const uint8_t* data, size_t size, size_t& padding) {
+    if (size == 0) return false;
     
-    uint8_t padding = data.back();
-    if (padding > 0 && padding <= AES::BLOCKSIZE) {
-        data.resize(data.size() - padding);
+    padding = data[size - 1];
+    if (padding == 0 || padding > AES::BLOCKSIZE || padding > size) {
+        return false;
+    }
+    for (size_t i = size - padding; i < size; i++) {
+        if (data[i] != padding) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool AESCrypto::removePadding(std::vector<uint8_t>& data) {
+    size_t padding = 0;
+    if (!paddingLength(data.data(), data.size(), padding)) {
+        return false;
     }
+    data.resize(data.size() - padding);
+    return true;
 }
 
 std::vector<uint8_t> AESCrypto::xorWithIV(const std::vector<uint8_t>& data, 
@@ -0,0 +1,123 @@
+// Codec ratio/throughput benchmark.
+// Compares the Huffman-only path (level 3) against LZ77 + Huffman at levels
+// 4, 6 and 9 on text, log and CSV inputs. Everything runs single-threaded.
+//
+//   make bench            (from sender/)
+//   ./codec_bench [MB]
+
+#include "codec.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace {
+
+std::vector<uint8_t> makeText(size_t size, std::mt19937& rng) {
+    static const char* words[] = {
+        "time", "capsule", "release", "the", "of", "and", "receiver", "sender",
+        "encrypted", "file", "key", "server", "a", "to", "in", "is", "will", "be"
+    };
+    std::vector<uint8_t> data;
+    data.reserve(size);
+    while (data.size() < size) {
+        const char* word = words[rng() % (sizeof(words) / sizeof(words[0]))];
+        data.insert(data.end(), word, word + std::char_traits<char>::length(word));
+        data.push_back(rng() % 12 == 0 ? '\n' : ' ');
+    }
+    data.resize(size);
+    return data;
+}
+
+std::vector<uint8_t> makeLog(size_t size, std::mt19937& rng) {
+    static const char* levels[] = {"INFO", "INFO", "INFO", "WARN", "ERROR"};
+    static const char* paths[] = {"/api/capsules", "/api/release", "/api/upload", "/health"};
+    std::vector<uint8_t> data;
+    data.reserve(size);
+    unsigned seconds = 0;
+    while (data.size() < size) {
+        seconds += rng() % 3;
+        std::string line = "2025-11-02T10:" + std::to_string(seconds / 60 % 60) + ":" +
+                           std::to_string(seconds % 60) + "Z " + levels[rng() % 5] +
+                           " GET " + paths[rng() % 4] + "/" + std::to_string(rng() % 5000) +
+                           " status=200 bytes=" + std::to_string(rng() % 100000) + "\n";
+        data.insert(data.end(), line.begin(), line.end());
+    }
+    data.resize(size);
+    return data;
+}
+
+std::vector<uint8_t> makeCsv(size_t size, std::mt19937& rng) {
+    static const char* names[] = {"alice", "bob", "carol", "dave", "erin", "frank"};
+    std::vector<uint8_t> data;
+    data.reserve(size);
+    unsigned id = 0;
+    while (data.size() < size) {
+        std::string row = std::to_string(id++) + "," + names[rng() % 6] + "," +
+                          std::to_string(rng() % 1000) + "." + std::to_string(rng() % 100) +
+                          ",pending,2025-11-0" + std::to_string(1 + rng() % 9) + "\n";
+        data.insert(data.end(), row.begin(), row.end());
+    }
+    data.resize(size);
+    return data;
+}
+
+template <typename F>
+double throughputMBs(size_t bytes, F&& run) {
+    const int repeats = 3;
+    double best = 1e30;
+    for (int i = 0; i < repeats; i++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return bytes / best / (1024.0 * 1024.0);
+}
+
+void runCase(const std::string& name, const std::vector<uint8_t>& data) {
+    for (int level : {3, 4, 6, 9}) {
+        std::unique_ptr<CompressionCodec> codec = createCodecForLevel(level);
+        codec->setThreadCount(1);
+        
+        std::vector<uint8_t> compressed, restored;
+        double compress_speed = throughputMBs(data.size(), [&]() {
+            codec->compressData(data, compressed);
+        });
+        double decompress_speed = throughputMBs(data.size(), [&]() {
+            codec->decompressData(compressed, restored);
+        });
+        if (restored != data) {
+            std::cerr << name << " level " << level << ": round trip failed" << std::endl;
+        }
+        
+        std::cout << std::left << std::setw(8) << name << std::setw(15) << codecName(codec->id())
+                  << std::right << std::setw(6) << level << std::fixed
+                  << std::setw(10) << std::setprecision(3)
+                  << static_cast<double>(compressed.size()) / data.size()
+                  << std::setw(12) << std::setprecision(1) << compress_speed << " MB/s"
+                  << std::setw(12) << decompress_speed << " MB/s" << std::endl;
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    size_t size = megabytes << 20;
+    std::mt19937 rng(42);
+    
+    std::cout << "Codec comparison, " << megabytes << " MB per input" << std::endl;
+    std::cout << std::left << std::setw(8) << "input" << std::setw(15) << "codec" << std::right
+              << std::setw(6) << "level" << std::setw(10) << "ratio"
+              << std::setw(17) << "compress" << std::setw(17) << "decompress" << std::endl;
+    
+    runCase("text", makeText(size, rng));
+    runCase("log", makeLog(size, rng));
+    runCase("csv", makeCsv(size, rng));
+    
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Batch SHA-256 benchmark.
+// Hashes many independent inputs one computeSHA256/computeFileSHA256 call
+// at a time and through the batch API (multi-buffer lanes, one thread and
+// all cores), for key-package sized, small-capsule and mixed inputs.
+// Digests from both paths are compared before timing is reported.
+//
+//   make bench            (from sender/)
+//   ./hash_bench [count]
+
+#include "hash_utils.h"
+#include "sha256_multi.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+std::vector<std::vector<uint8_t>> makeInputs(size_t count, size_t min_size, size_t max_size,
+                                             std::mt19937& rng) {
+    std::vector<std::vector<uint8_t>> inputs(count);
+    for (std::vector<uint8_t>& input : inputs) {
+        input.resize(min_size + rng() % (max_size - min_size + 1));
+        for (uint8_t& byte : input) {
+            byte = static_cast<uint8_t>(rng());
+        }
+    }
+    return inputs;
+}
+
+template <typename F>
+double bestSeconds(F&& run) {
+    const int repeats = 3;
+    double best = 1e30;
+    for (int i = 0; i < repeats; i++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+void report(const std::string& input, const std::string& path, size_t count, size_t bytes,
+            double seconds, double serial_seconds) {
+    std::cout << std::left << std::setw(10) << input << std::setw(16) << path << std::right
+              << std::fixed << std::setw(12) << std::setprecision(0) << count / seconds << " files/s"
+              << std::setw(9) << std::setprecision(3) << bytes / seconds / 1e9 << " GB/s"
+              << std::setw(8) << std::setprecision(2) << serial_seconds / seconds << "x" << std::endl;
+}
+
+void runMemoryCase(const std::string& name, const std::vector<std::vector<uint8_t>>& inputs) {
+    size_t bytes = 0;
+    for (const std::vector<uint8_t>& input : inputs) {
+        bytes += input.size();
+    }
+    
+    HashUtils hasher;
+    std::vector<std::string> serial(inputs.size()), batch;
+    double serial_seconds = bestSeconds([&]() {
+        for (size_t i = 0; i < inputs.size(); i++) {
+            serial[i] = hasher.computeSHA256(inputs[i]);
+        }
+    });
+    report(name, "serial", inputs.size(), bytes, serial_seconds, serial_seconds);
+    
+    for (size_t threads : {1, 0}) {
+        double seconds = bestSeconds([&]() {
+            batch = HashUtils::computeSHA256Batch(inputs, threads);
+        });
+        if (batch != serial) {
+            std::cerr << name << ": batch digests differ from serial ones" << std::endl;
+        }
+        report(name, threads == 1 ? "batch 1 thread" : "batch all cores", inputs.size(), bytes,
+               seconds, serial_seconds);
+    }
+}
+
+void runFileCase(const std::string& name, const std::vector<std::vector<uint8_t>>& inputs) {
+    char directory[] = "/tmp/hash_bench.XXXXXX";
+    if (!mkdtemp(directory)) {
+        std::cerr << "Cannot create temporary directory" << std::endl;
+        return;
+    }
+    
+    size_t bytes = 0;
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        paths.push_back(std::string(directory) + "/" + std::to_string(i));
+        std::ofstream file(paths.back(), std::ios::binary);
+        file.write(reinterpret_cast<const char*>(inputs[i].data()), inputs[i].size());
+        bytes += inputs[i].size();
+    }
+    
+    // Timed with the files in the page cache, as in a nightly check of
+    // recently written capsules
+    HashUtils hasher;
+    std::vector<std::string> serial(paths.size()), batch;
+    double serial_seconds = bestSeconds([&]() {
+        for (size_t i = 0; i < paths.size(); i++) {
+            serial[i] = hasher.computeFileSHA256(paths[i]);
+        }
+    });
+    report(name, "serial", paths.size(), bytes, serial_seconds, serial_seconds);
+    
+    for (size_t threads : {1, 0}) {
+        double seconds = bestSeconds([&]() {
+            batch = hasher.computeFileSHA256Batch(paths, threads);
+        });
+        if (batch != serial) {
+            std::cerr << name << ": batch digests differ from serial ones" << std::endl;
+        }
+        report(name, threads == 1 ? "batch 1 thread" : "batch all cores", paths.size(), bytes,
+               seconds, serial_seconds);
+    }
+    
+    for (const std::string& path : paths) {
+        std::remove(path.c_str());
+    }
+    rmdir(directory);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4096;
+    std::mt19937 rng(42);
+    
+    std::cout << "Batch SHA-256, " << count << " inputs per case, multi-buffer lanes "
+              << (MultiBufferSHA256::accelerated() ? "AVX2" : "unavailable") << std::endl;
+    
+    // Key packages are a few hundred bytes; small capsules a few KB
+    std::vector<std::vector<uint8_t>> packages = makeInputs(count, 384, 640, rng);
+    std::vector<std::vector<uint8_t>> capsules = makeInputs(count, 2048, 16384, rng);
+    std::vector<std::vector<uint8_t>> mixed = makeInputs(count, 64, 65536, rng);
+    
+    std::cout << "-- memory" << std::endl;
+    runMemoryCase("packages", packages);
+    runMemoryCase("capsules", capsules);
+    runMemoryCase("mixed", mixed);
+    
+    std::cout << "-- files" << std::endl;
+    runFileCase("packages", packages);
+    runFileCase("capsules", capsules);
+    runFileCase("mixed", mixed);
+    
+    return 0;
+}
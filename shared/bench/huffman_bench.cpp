@@ -0,0 +1,198 @@
+// Huffman encoder microbenchmark.
+// Compares HuffmanCompressor::compressData (packed codewords, 64-bit
+// accumulator) against the previous string-code encoder on text, binary
+// and already-compressed inputs. Both run single-threaded. The entropy
+// probe is off, so every block is histogrammed and given a code; blocks
+// whose code would not shrink them (the already-compressed row, ratio 1.0)
+// are still stored after that, without running the encoder loop.
+//
+//   make bench            (from sender/)
+//   ./huffman_bench [MB]
+
+#include "huffman.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+
+namespace {
+
+struct ReferenceNode {
+    uint8_t byte;
+    unsigned frequency;
+    std::shared_ptr<ReferenceNode> left;
+    std::shared_ptr<ReferenceNode> right;
+    
+    ReferenceNode(uint8_t b, unsigned freq) : byte(b), frequency(freq) {}
+    
+    bool isLeaf() const {
+        return left == nullptr && right == nullptr;
+    }
+};
+
+struct CompareReferenceNodes {
+    bool operator()(const std::shared_ptr<ReferenceNode>& a,
+                    const std::shared_ptr<ReferenceNode>& b) {
+        return a->frequency > b->frequency;
+    }
+};
+
+// Previous encoder: map-based histogram, string codes, one bit at a time
+std::vector<uint8_t> referenceEncode(const std::vector<uint8_t>& data) {
+    std::map<uint8_t, unsigned> frequency;
+    for (uint8_t byte : data) {
+        frequency[byte]++;
+    }
+    
+    std::priority_queue<std::shared_ptr<ReferenceNode>,
+                        std::vector<std::shared_ptr<ReferenceNode>>,
+                        CompareReferenceNodes> pq;
+    for (const auto& pair : frequency) {
+        pq.push(std::make_shared<ReferenceNode>(pair.first, pair.second));
+    }
+    while (pq.size() > 1) {
+        auto left = pq.top(); pq.pop();
+        auto right = pq.top(); pq.pop();
+        auto parent = std::make_shared<ReferenceNode>(0, left->frequency + right->frequency);
+        parent->left = left;
+        parent->right = right;
+        pq.push(parent);
+    }
+    
+    std::map<uint8_t, std::string> codes;
+    std::function<void(const std::shared_ptr<ReferenceNode>&, const std::string&)> generate;
+    generate = [&](const std::shared_ptr<ReferenceNode>& node, const std::string& code) {
+        if (node->isLeaf()) {
+            codes[node->byte] = code.empty() ? "0" : code;
+        } else {
+            generate(node->left, code + "0");
+            generate(node->right, code + "1");
+        }
+    };
+    generate(pq.top(), "");
+    
+    std::vector<uint8_t> encoded;
+    size_t bit_pos = 0;
+    uint8_t current_byte = 0;
+    for (uint8_t byte : data) {
+        const std::string& code = codes[byte];
+        for (char bit : code) {
+            if (bit == '1') {
+                current_byte |= (1 << (7 - bit_pos));
+            }
+            if (++bit_pos == 8) {
+                encoded.push_back(current_byte);
+                current_byte = 0;
+                bit_pos = 0;
+            }
+        }
+    }
+    if (bit_pos > 0) {
+        encoded.push_back(current_byte);
+    }
+    return encoded;
+}
+
+std::vector<uint8_t> makeText(size_t size, std::mt19937& rng) {
+    static const char* words[] = {
+        "time", "capsule", "release", "the", "of", "and", "receiver", "sender",
+        "encrypted", "file", "key", "server", "a", "to", "in", "is", "2025-11-02,"
+    };
+    std::vector<uint8_t> data;
+    data.reserve(size);
+    while (data.size() < size) {
+        const char* word = words[rng() % (sizeof(words) / sizeof(words[0]))];
+        data.insert(data.end(), word, word + std::char_traits<char>::length(word));
+        data.push_back(rng() % 12 == 0 ? '\n' : ' ');
+    }
+    data.resize(size);
+    return data;
+}
+
+std::vector<uint8_t> makeBinary(size_t size, std::mt19937& rng) {
+    // Executable-like mix: zero runs, small integers and random bytes
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        unsigned r = rng();
+        if (r % 4 == 0) {
+            data[i] = 0;
+        } else if (r % 4 == 1) {
+            data[i] = static_cast<uint8_t>((r >> 8) % 16);
+        } else {
+            data[i] = static_cast<uint8_t>(r >> 16);
+        }
+    }
+    return data;
+}
+
+std::vector<uint8_t> makeCompressed(size_t size, std::mt19937& rng) {
+    std::vector<uint8_t> data(size);
+    for (auto& byte : data) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    return data;
+}
+
+template <typename F>
+double throughputMBs(size_t bytes, F&& run) {
+    const int repeats = 3;
+    double best = 1e30;
+    for (int i = 0; i < repeats; i++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return bytes / best / (1024.0 * 1024.0);
+}
+
+void runCase(const std::string& name, const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> reference;
+    double reference_speed = throughputMBs(data.size(), [&]() {
+        reference = referenceEncode(data);
+    });
+    
+    HuffmanCompressor compressor;
+    compressor.setThreadCount(1);
+    compressor.setEntropyProbe(false);
+    std::vector<uint8_t> packed;
+    double packed_speed = throughputMBs(data.size(), [&]() {
+        compressor.compressData(data, packed);
+    });
+    
+    std::cout << std::left << std::setw(12) << name << std::right << std::fixed
+              << std::setprecision(1)
+              << std::setw(12) << reference_speed << " MB/s"
+              << std::setw(12) << packed_speed << " MB/s"
+              << std::setw(9) << packed_speed / reference_speed << "x"
+              << std::setw(10) << std::setprecision(3)
+              << static_cast<double>(packed.size()) / data.size() << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    size_t size = megabytes << 20;
+    std::mt19937 rng(42);
+    
+    std::cout << "Huffman encode, " << megabytes << " MB per input" << std::endl;
+    std::cout << std::left << std::setw(12) << "input" << std::right
+              << std::setw(17) << "string codes"
+              << std::setw(17) << "packed codes"
+              << std::setw(10) << "speedup"
+              << std::setw(10) << "ratio" << std::endl;
+    
+    runCase("text", makeText(size, rng));
+    runCase("binary", makeBinary(size, rng));
+    runCase("compressed", makeCompressed(size, rng));
+    
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "codec.h"
+#include "huffman.h"
+#include "lz77.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// Every codec shares the block container; they differ only in how
+// HuffmanCompressor transforms each block before writing it
+class ContainerCodec : public CompressionCodec {
+public:
+    ContainerCodec(CodecId id, int match_chain) : id_(id) {
+        compressor_.setCodec(id);
+        compressor_.setMatchChain(match_chain);
+    }
+    
+    CodecId id() const override {
+        return id_;
+    }
+    
+    bool compressFile(const std::string& input_file, const std::string& output_file) override {
+        return compressor_.compressFile(input_file, output_file);
+    }
+    
+    bool compressFile(const std::string& input_file, const ByteSink& sink) override {
+        return compressor_.compressFile(input_file, sink);
+    }
+    
+    bool decompressFile(const std::string& input_file, const std::string& output_file) override {
+        return compressor_.decompressFile(input_file, output_file);
+    }
+    
+    bool compressData(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) override {
+        return compressor_.compressData(input, output);
+    }
+    
+    bool decompressData(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) override {
+        return compressor_.decompressData(input, output);
+    }
+    
+    void setThreadCount(size_t thread_count) override {
+        compressor_.setThreadCount(thread_count);
+    }
+
+private:
+    CodecId id_;
+    HuffmanCompressor compressor_;
+};
+
+std::unique_ptr<CompressionCodec> makeCodec(CodecId id, int match_chain) {
+    return std::unique_ptr<CompressionCodec>(new ContainerCodec(id, match_chain));
+}
+
+} // namespace
+
+const char* codecName(CodecId id) {
+    switch (id) {
+        case CodecId::Store:       return "store";
+        case CodecId::Huffman:     return "huffman";
+        case CodecId::Lz77Huffman: return "lz77+huffman";
+    }
+    return "unknown";
+}
+
+std::unique_ptr<CompressionCodec> createCodec(CodecId id) {
+    return makeCodec(id, Lz77Matcher::kDefaultMaxChain);
+}
+
+std::unique_ptr<CompressionCodec> createCodecForLevel(int level) {
+    level = std::max(kMinCompressionLevel, std::min(level, kMaxCompressionLevel));
+    if (level == 0) {
+        return makeCodec(CodecId::Store, Lz77Matcher::kDefaultMaxChain);
+    }
+    if (level <= 3) {
+        return makeCodec(CodecId::Huffman, Lz77Matcher::kDefaultMaxChain);
+    }
+    // Levels 4-9 try 4 to 128 match candidates per position
+    return makeCodec(CodecId::Lz77Huffman, 4 << (level - 4));
+}
+
+uint64_t maxCompressedSize(uint64_t input_size) {
+    return HuffmanCompressor::maxContainerSize(input_size);
+}
+
+std::unique_ptr<StreamDecompressor> createStreamDecompressor(const ByteSink& sink, size_t threads) {
+    HuffmanCompressor decoder;
+    decoder.setThreadCount(threads);
+    return decoder.createStreamDecompressor(sink);
+}
+
+bool readCodecId(const std::string& compressed_file, CodecId& id) {
+    if (!HuffmanCompressor::readCodec(compressed_file, id)) {
+        std::cerr << "Unrecognized compressed file: " << compressed_file << std::endl;
+        return false;
+    }
+    return true;
+}
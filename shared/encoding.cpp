@@ -0,0 +1,343 @@
+#include "encoding.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ENCODING_SSSE3 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// All-ones when a < b, else zero; a and b below 2^31
+inline uint32_t lessMask(uint32_t a, uint32_t b) {
+    return 0u - ((a - b) >> 31);
+}
+
+inline uint32_t rangeMask(uint32_t c, uint32_t low, uint32_t high) {
+    return ~lessMask(c, low) & lessMask(c, high + 1);
+}
+
+inline char hexDigit(uint32_t nibble) {
+    // '0' + nibble, plus the gap up to 'a' when nibble > 9
+    return static_cast<char>(nibble + '0' + (~lessMask(nibble, 10) & ('a' - '0' - 10)));
+}
+
+// Value of a hex digit; `valid` is cleared when c is not one
+inline uint32_t hexValue(uint8_t c, uint32_t& valid) {
+    uint32_t digit = rangeMask(c, '0', '9');
+    uint32_t lower = c | 0x20;
+    uint32_t alpha = rangeMask(lower, 'a', 'f');
+    valid &= digit | alpha;
+    return (digit & (c - '0')) | (alpha & (lower - 'a' + 10));
+}
+
+inline char base64Digit(uint32_t sextet) {
+    uint32_t upper = lessMask(sextet, 26);
+    uint32_t lower = rangeMask(sextet, 26, 51);
+    uint32_t digit = rangeMask(sextet, 52, 61);
+    uint32_t plus = rangeMask(sextet, 62, 62);
+    uint32_t slash = rangeMask(sextet, 63, 63);
+    return static_cast<char>((upper & (sextet + 'A')) | (lower & (sextet - 26 + 'a')) |
+                             (digit & (sextet - 52 + '0')) | (plus & '+') | (slash & '/'));
+}
+
+inline uint32_t base64Value(uint8_t c, uint32_t& valid) {
+    uint32_t upper = rangeMask(c, 'A', 'Z');
+    uint32_t lower = rangeMask(c, 'a', 'z');
+    uint32_t digit = rangeMask(c, '0', '9');
+    uint32_t plus = rangeMask(c, '+', '+');
+    uint32_t slash = rangeMask(c, '/', '/');
+    valid &= upper | lower | digit | plus | slash;
+    return (upper & (c - 'A')) | (lower & (c - 'a' + 26)) | (digit & (c - '0' + 52)) |
+           (plus & 62) | (slash & 63);
+}
+
+#ifdef ENCODING_SSSE3
+
+bool hasSsse3() {
+    static const bool supported = __builtin_cpu_supports("ssse3");
+    return supported;
+}
+
+// The lookups below are pshufb shuffles of a register, not memory reads
+
+// Encodes whole 16-byte blocks; returns the bytes consumed
+__attribute__((target("ssse3")))
+size_t hexEncodeBlocks(const uint8_t* data, size_t size, char* out) {
+    const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                         '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i low_nibble = _mm_set1_epi8(0x0f);
+    size_t done = 0;
+    for (; done + 16 <= size; done += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + done));
+        __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(bytes, 4), low_nibble));
+        __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(bytes, low_nibble));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * done), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * done + 16), _mm_unpackhi_epi8(high, low));
+    }
+    return done;
+}
+
+__attribute__((target("ssse3")))
+inline __m128i hexNibbles(__m128i chars, __m128i& invalid) {
+    __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+    __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(digit, _mm_set1_epi8(-1)),
+                                     _mm_cmpgt_epi8(_mm_set1_epi8(10), digit));
+    __m128i alpha = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_alpha = _mm_and_si128(_mm_cmpgt_epi8(alpha, _mm_set1_epi8(-1)),
+                                     _mm_cmpgt_epi8(_mm_set1_epi8(6), alpha));
+    invalid = _mm_or_si128(invalid, _mm_andnot_si128(_mm_or_si128(is_digit, is_alpha), _mm_set1_epi8(-1)));
+    return _mm_or_si128(_mm_and_si128(is_digit, digit),
+                        _mm_and_si128(is_alpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+}
+
+// Decodes whole 32-digit blocks; returns the digits consumed and clears
+// `valid` if any of them is not a hex digit
+__attribute__((target("ssse3")))
+size_t hexDecodeBlocks(const char* hex, size_t length, uint8_t* out, uint32_t& valid) {
+    // Each (high, low) nibble pair becomes high * 16 + low in a 16-bit lane
+    const __m128i weights = _mm_set1_epi16(0x0110);
+    __m128i invalid = _mm_setzero_si128();
+    size_t done = 0;
+    for (; done + 32 <= length; done += 32) {
+        __m128i first = hexNibbles(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + done)), invalid);
+        __m128i second = hexNibbles(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + done + 16)), invalid);
+        __m128i bytes = _mm_packus_epi16(_mm_maddubs_epi16(first, weights),
+                                         _mm_maddubs_epi16(second, weights));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + done / 2), bytes);
+    }
+    valid &= _mm_movemask_epi8(invalid) == 0 ? ~0u : 0u;
+    return done;
+}
+
+// Encodes 12 input bytes into 16 characters per step while 16 bytes can
+// be loaded; returns the bytes consumed
+__attribute__((target("ssse3")))
+size_t base64EncodeBlocks(const uint8_t* data, size_t size, char* out) {
+    // Spreads each 3-byte group over a 32-bit lane, then moves its four
+    // sextets into separate bytes
+    const __m128i spread = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    // Offset from sextet to character for A-Z, a-z, 0-9 (10 entries), '+', '/'
+    const __m128i offsets = _mm_setr_epi8('A', 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '+' - 62, '/' - 63, 0, 0);
+    size_t done = 0;
+    size_t written = 0;
+    for (; done + 16 <= size; done += 12, written += 16) {
+        __m128i bytes = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + done)), spread);
+        __m128i high = _mm_mulhi_epu16(_mm_and_si128(bytes, _mm_set1_epi32(0x0fc0fc00)),
+                                       _mm_set1_epi32(0x04000040));
+        __m128i low = _mm_mullo_epi16(_mm_and_si128(bytes, _mm_set1_epi32(0x003f03f0)),
+                                      _mm_set1_epi32(0x01000010));
+        __m128i sextets = _mm_or_si128(high, low);
+        
+        // Range index: 0 for A-Z, 1 for a-z, 2-11 for digits, 12 '+', 13 '/'
+        __m128i range = _mm_subs_epu8(sextets, _mm_set1_epi8(51));
+        range = _mm_sub_epi8(range, _mm_cmpgt_epi8(sextets, _mm_set1_epi8(25)));
+        __m128i chars = _mm_add_epi8(sextets, _mm_shuffle_epi8(offsets, range));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written), chars);
+    }
+    return done;
+}
+
+// Decodes 16 characters into 12 bytes per step while at least 24
+// characters remain, so the 16-byte store stays inside the output. Stops
+// at the first block holding anything but base64 digits (padding
+// included), leaving it to the scalar decoder. Returns characters consumed.
+__attribute__((target("ssse3")))
+size_t base64DecodeBlocks(const char* text, size_t length, uint8_t* out) {
+    // Classify each character by its nibbles: a set bit shared by the
+    // low- and high-nibble entries marks a character outside the alphabet
+    const __m128i low_classes = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                              0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i high_classes = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                               0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    // Offset from character to sextet by high nibble ('/' has its own slot)
+    const __m128i offsets = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i slash = _mm_set1_epi8(0x2f);
+    const __m128i gather = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t done = 0;
+    size_t written = 0;
+    for (; done + 24 <= length; done += 16, written += 12) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + done));
+        __m128i high_nibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), slash);
+        __m128i low_nibbles = _mm_and_si128(chars, slash);
+        __m128i high = _mm_shuffle_epi8(high_classes, high_nibbles);
+        __m128i low = _mm_shuffle_epi8(low_classes, low_nibbles);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(low, high), _mm_setzero_si128())) != 0xffff) {
+            break;
+        }
+        
+        __m128i is_slash = _mm_cmpeq_epi8(chars, slash);
+        __m128i sextets = _mm_add_epi8(chars, _mm_shuffle_epi8(offsets, _mm_add_epi8(is_slash, high_nibbles)));
+        
+        // Packs four sextets into three bytes per 32-bit lane, then drops
+        // the empty fourth byte of each lane
+        __m128i pairs = _mm_maddubs_epi16(sextets, _mm_set1_epi32(0x01400140));
+        __m128i groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written), _mm_shuffle_epi8(groups, gather));
+    }
+    return done;
+}
+
+#endif // ENCODING_SSSE3
+
+} // namespace
+
+namespace Encoding {
+
+void hexEncode(const uint8_t* data, size_t size, char* out) {
+    size_t done = 0;
+#ifdef ENCODING_SSSE3
+    if (hasSsse3()) {
+        done = hexEncodeBlocks(data, size, out);
+    }
+#endif
+    for (; done < size; done++) {
+        out[2 * done] = hexDigit(data[done] >> 4);
+        out[2 * done + 1] = hexDigit(data[done] & 0x0f);
+    }
+}
+
+bool hexDecode(const char* hex, size_t length, uint8_t* out) {
+    if (length % 2 != 0) {
+        return false;
+    }
+    
+    // Validity is gathered over the whole input, so a bad digit does not
+    // end the loop early
+    uint32_t valid = ~0u;
+    size_t done = 0;
+#ifdef ENCODING_SSSE3
+    if (hasSsse3()) {
+        done = hexDecodeBlocks(hex, length, out, valid);
+    }
+#endif
+    for (; done < length; done += 2) {
+        uint32_t high = hexValue(static_cast<uint8_t>(hex[done]), valid);
+        uint32_t low = hexValue(static_cast<uint8_t>(hex[done + 1]), valid);
+        out[done / 2] = static_cast<uint8_t>((high << 4) | low);
+    }
+    return valid != 0;
+}
+
+void base64Encode(const uint8_t* data, size_t size, char* out) {
+    size_t done = 0;
+#ifdef ENCODING_SSSE3
+    if (hasSsse3()) {
+        done = base64EncodeBlocks(data, size, out);
+    }
+#endif
+    char* next = out + done / 3 * 4;
+    for (; done + 3 <= size; done += 3) {
+        uint32_t group = (static_cast<uint32_t>(data[done]) << 16) |
+                         (static_cast<uint32_t>(data[done + 1]) << 8) | data[done + 2];
+        *next++ = base64Digit(group >> 18);
+        *next++ = base64Digit((group >> 12) & 0x3f);
+        *next++ = base64Digit((group >> 6) & 0x3f);
+        *next++ = base64Digit(group & 0x3f);
+    }
+    
+    size_t remainder = size - done;
+    if (remainder > 0) {
+        uint32_t group = static_cast<uint32_t>(data[done]) << 16;
+        if (remainder == 2) {
+            group |= static_cast<uint32_t>(data[done + 1]) << 8;
+        }
+        *next++ = base64Digit(group >> 18);
+        *next++ = base64Digit((group >> 12) & 0x3f);
+        *next++ = remainder == 2 ? base64Digit((group >> 6) & 0x3f) : '=';
+        *next++ = '=';
+    }
+}
+
+bool base64Decode(const char* text, size_t length, uint8_t* out, size_t& out_size) {
+    out_size = 0;
+    size_t padding = 0;
+    if (length % 4 == 0) {
+        while (padding < 2 && padding < length && text[length - 1 - padding] == '=') {
+            padding++;
+        }
+    }
+    size_t digits = length - padding;
+    if (digits % 4 == 1) {
+        return false;
+    }
+    
+    uint32_t valid = ~0u;
+    size_t done = 0;
+#ifdef ENCODING_SSSE3
+    if (hasSsse3()) {
+        done = base64DecodeBlocks(text, digits, out);
+    }
+#endif
+    uint8_t* next = out + done / 4 * 3;
+    for (; done + 4 <= digits; done += 4) {
+        uint32_t group = (base64Value(static_cast<uint8_t>(text[done]), valid) << 18) |
+                         (base64Value(static_cast<uint8_t>(text[done + 1]), valid) << 12) |
+                         (base64Value(static_cast<uint8_t>(text[done + 2]), valid) << 6) |
+                         base64Value(static_cast<uint8_t>(text[done + 3]), valid);
+        *next++ = static_cast<uint8_t>(group >> 16);
+        *next++ = static_cast<uint8_t>(group >> 8);
+        *next++ = static_cast<uint8_t>(group);
+    }
+    
+    // A final group of two or three digits carries one or two bytes; the
+    // bits past them must be zero so every input decodes one way only
+    size_t remainder = digits - done;
+    if (remainder > 0) {
+        uint32_t group = (base64Value(static_cast<uint8_t>(text[done]), valid) << 18) |
+                         (base64Value(static_cast<uint8_t>(text[done + 1]), valid) << 12);
+        if (remainder == 3) {
+            group |= base64Value(static_cast<uint8_t>(text[done + 2]), valid) << 6;
+        }
+        *next++ = static_cast<uint8_t>(group >> 16);
+        if (remainder == 3) {
+            *next++ = static_cast<uint8_t>(group >> 8);
+            valid &= (group & 0xff) == 0 ? ~0u : 0u;
+        } else {
+            valid &= (group & 0xffff) == 0 ? ~0u : 0u;
+        }
+    }
+    
+    if (valid == 0) {
+        return false;
+    }
+    out_size = static_cast<size_t>(next - out);
+    return true;
+}
+
+std::string toHex(const uint8_t* data, size_t size) {
+    std::string hex(size * 2, '\0');
+    hexEncode(data, size, &hex[0]);
+    return hex;
+}
+
+std::string toHex(const std::vector<uint8_t>& data) {
+    return toHex(data.data(), data.size());
+}
+
+std::vector<uint8_t> fromHex(const std::string& hex) {
+    std::vector<uint8_t> bytes(hex.size() / 2);
+    if (!hexDecode(hex.data(), hex.size(), bytes.data())) {
+        return {};
+    }
+    return bytes;
+}
+
+std::string toBase64(const std::vector<uint8_t>& data) {
+    std::string text(base64EncodedSize(data.size()), '\0');
+    base64Encode(data.data(), data.size(), &text[0]);
+    return text;
+}
+
+std::vector<uint8_t> fromBase64(const std::string& text) {
+    std::vector<uint8_t> bytes(base64DecodedMaxSize(text.size()));
+    size_t size = 0;
+    if (!base64Decode(text.data(), text.size(), bytes.data(), size)) {
+        return {};
+    }
+    bytes.resize(size);
+    return bytes;
+}
+
+} // namespace Encoding
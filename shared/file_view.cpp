@@ -0,0 +1,118 @@
+#include "file_view.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <iterator>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const size_t kReadChunkSize = 1 << 16;
+
+#ifndef _WIN32
+// Buffered fallback for descriptors that cannot be mapped; reads until EOF
+// since pipes and character devices report no size up front
+bool readAll(int fd, std::vector<uint8_t>& data) {
+    data.clear();
+    size_t used = 0;
+    while (true) {
+        if (data.size() - used < kReadChunkSize) {
+            data.resize(used + kReadChunkSize);
+        }
+        ssize_t got = ::read(fd, data.data() + used, data.size() - used);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (got == 0) {
+            break;
+        }
+        used += static_cast<size_t>(got);
+    }
+    data.resize(used);
+    return true;
+}
+#endif
+
+} // namespace
+
+FileView::FileView() : data_(nullptr), size_(0), mapping_(nullptr), mapping_size_(0) {}
+
+FileView::~FileView() {
+    close();
+}
+
+void FileView::close() {
+#ifndef _WIN32
+    if (mapping_) {
+        munmap(mapping_, mapping_size_);
+    }
+#endif
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+    std::vector<uint8_t>().swap(buffer_);
+    data_ = nullptr;
+    size_ = 0;
+}
+
+bool FileView::open(const std::string& path) {
+    close();
+
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot open input file: " << path << std::endl;
+        return false;
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (file.bad()) {
+        std::cerr << "Failed to read input file: " << path << std::endl;
+        buffer_.clear();
+        return false;
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Cannot open input file: " << path << std::endl;
+        return false;
+    }
+    
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        size_t length = static_cast<size_t>(info.st_size);
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            // Only a hint; the view is correct without it
+            madvise(mapping, length, MADV_SEQUENTIAL);
+            ::close(fd);
+            mapping_ = mapping;
+            mapping_size_ = length;
+            data_ = static_cast<const uint8_t*>(mapping);
+            size_ = length;
+            return true;
+        }
+    }
+    
+    // Pipes, devices, empty (possibly procfs) files and failed mappings
+    bool ok = readAll(fd, buffer_);
+    ::close(fd);
+    if (!ok) {
+        std::cerr << "Failed to read input file: " << path << ": " << std::strerror(errno) << std::endl;
+        buffer_.clear();
+        return false;
+    }
+#endif
+
+    data_ = buffer_.empty() ? nullptr : buffer_.data();
+    size_ = buffer_.size();
+    return true;
+}
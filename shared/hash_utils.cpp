@@ -0,0 +1,647 @@
+#include "hash_utils.h"
+#include "file_view.h"
+#include "thread_pool.h"
+#include "sha256_multi.h"
+#include "encoding.h"
+#define CRYPTOPP_ENABLE_NAMESPACE_WEAK 1
+#include <cryptopp/sha.h>
+#include <cryptopp/md5.h>
+#include <cryptopp/hmac.h>
+#include <cryptopp/pwdbased.h>
+#include <cryptopp/osrng.h>
+#include <cryptopp/misc.h>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <future>
+#include <sstream>
+#include <sys/stat.h>
+
+using namespace CryptoPP;
+
+namespace {
+
+// Large enough that per-read overhead vanishes next to hashing, small
+// enough to stay in L2 while it is hashed
+const size_t kFileBufferSize = 1 << 20;
+
+std::unique_ptr<HashTransformation> createHash(const std::string& algorithm) {
+    if (algorithm == "SHA256") {
+        return std::unique_ptr<HashTransformation>(new SHA256());
+    }
+    if (algorithm == "SHA1") {
+        return std::unique_ptr<HashTransformation>(new SHA1());
+    }
+    if (algorithm == "MD5") {
+        return std::unique_ptr<HashTransformation>(new Weak::MD5());
+    }
+    return nullptr;
+}
+
+std::string finalHex(HashTransformation& hash) {
+    uint8_t digest[64];
+    hash.Final(digest);
+    return Encoding::toHex(digest, hash.DigestSize());
+}
+
+// Domain separation between tree leaves and interior nodes, so a chunk can
+// never be passed off as a pair of child hashes
+const uint8_t kTreeLeafPrefix = 0x00;
+const uint8_t kTreeNodePrefix = 0x01;
+
+std::string treeLeaf(const uint8_t* data, size_t size) {
+    SHA256 hash;
+    hash.Update(&kTreeLeafPrefix, 1);
+    hash.Update(data, size);
+    return finalHex(hash);
+}
+
+// Smaller batches are hashed on the calling thread; starting workers would
+// cost more than it saves
+const size_t kParallelBatchBytes = 4 << 20;
+// Lane groups and long inputs are handed to workers in tasks of about this
+// many bytes
+const size_t kBatchTaskBytes = 1 << 20;
+
+// Indices of up to MultiBufferSHA256::kLanes inputs hashed together, or of
+// one input hashed alone
+typedef std::vector<size_t> BatchGroup;
+
+std::vector<BatchGroup> groupBatch(const std::vector<size_t>& sizes) {
+    std::vector<BatchGroup> groups;
+    std::vector<size_t> short_inputs;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        if (MultiBufferSHA256::preferred(sizes[i])) {
+            short_inputs.push_back(i);
+        } else {
+            groups.push_back(BatchGroup(1, i));
+        }
+    }
+    
+    // Lanes idle once their input runs out, so lanes are filled with inputs
+    // of similar size
+    std::stable_sort(short_inputs.begin(), short_inputs.end(),
+                     [&sizes](size_t a, size_t b) { return sizes[a] < sizes[b]; });
+    for (size_t first = 0; first < short_inputs.size(); first += MultiBufferSHA256::kLanes) {
+        size_t last = std::min(first + MultiBufferSHA256::kLanes, short_inputs.size());
+        groups.push_back(BatchGroup(short_inputs.begin() + first, short_inputs.begin() + last));
+    }
+    return groups;
+}
+
+template <typename F>
+void runBatch(const std::vector<BatchGroup>& groups, const std::vector<size_t>& sizes,
+              size_t threads, F hash_group) {
+    size_t total_bytes = 0;
+    for (size_t size : sizes) {
+        total_bytes += size;
+    }
+    if (threads == 0) {
+        threads = ThreadPool::defaultThreadCount();
+    }
+    if (total_bytes < kParallelBatchBytes || groups.size() < 2 || threads <= 1) {
+        for (const BatchGroup& group : groups) {
+            hash_group(group);
+        }
+        return;
+    }
+    
+    ThreadPool pool(std::min(threads, groups.size()));
+    std::vector<std::future<void>> pending;
+    size_t first = 0;
+    while (first < groups.size()) {
+        size_t last = first;
+        size_t task_bytes = 0;
+        while (last < groups.size() && (last == first || task_bytes < kBatchTaskBytes)) {
+            for (size_t index : groups[last]) {
+                task_bytes += sizes[index];
+            }
+            last++;
+        }
+        pending.push_back(pool.submit([&groups, &hash_group, first, last]() {
+            for (size_t i = first; i < last; i++) {
+                hash_group(groups[i]);
+            }
+        }));
+        first = last;
+    }
+    for (std::future<void>& task : pending) {
+        task.get();
+    }
+}
+
+void hashGroup(const BatchGroup& group, const uint8_t* const* data, const size_t* sizes,
+               std::vector<std::string>& digests) {
+    uint8_t lane_digests[MultiBufferSHA256::kLanes * MultiBufferSHA256::kDigestSize];
+    MultiBufferSHA256::hash(data, sizes, group.size(), lane_digests);
+    for (size_t lane = 0; lane < group.size(); lane++) {
+        digests[group[lane]] = Encoding::toHex(lane_digests + lane * MultiBufferSHA256::kDigestSize,
+                                               MultiBufferSHA256::kDigestSize);
+    }
+}
+
+} // namespace
+
+struct HashUtils::State {
+    SHA256 sha256;
+};
+
+HashUtils::HashUtils() : progress_callback_(nullptr), state_(new State()) {
+}
+
+HashUtils::~HashUtils() {
+}
+
+void HashUtils::update(const uint8_t* data, size_t size) {
+    state_->sha256.Update(data, size);
+}
+
+void HashUtils::update(const std::vector<uint8_t>& data) {
+    update(data.data(), data.size());
+}
+
+std::string HashUtils::finalize() {
+    // Final() also restarts the hash for the next message
+    return finalHex(state_->sha256);
+}
+
+void HashUtils::reset() {
+    state_->sha256.Restart();
+}
+
+bool HashUtils::computeFileTreeHash(const std::string& file_path, TreeHash& tree,
+                                    size_t threads, size_t chunk_size) {
+    tree.chunk_size = chunk_size;
+    tree.root.clear();
+    if (!computeTreeLeaves(file_path, chunk_size, threads, tree.leaves)) {
+        tree.leaves.clear();
+        return false;
+    }
+    tree.root = computeTreeRoot(tree.leaves);
+    return !tree.root.empty();
+}
+
+bool HashUtils::verifyFileTreeHash(const std::string& file_path, const TreeHash& tree,
+                                   std::vector<size_t>& corrupt_chunks, size_t threads) {
+    corrupt_chunks.clear();
+    
+    // The leaf list travels with the root, so it is only trusted once it
+    // reproduces the root
+    if (tree.root.empty() || !compareHashes(computeTreeRoot(tree.leaves), tree.root)) {
+        std::cerr << "Tree hash leaves do not match the tree root" << std::endl;
+        return false;
+    }
+    
+    std::vector<std::string> leaves;
+    if (!computeTreeLeaves(file_path, tree.chunk_size, threads, leaves)) {
+        return false;
+    }
+    size_t chunk_count = std::max(leaves.size(), tree.leaves.size());
+    for (size_t i = 0; i < chunk_count; i++) {
+        if (i >= leaves.size() || i >= tree.leaves.size() || !compareHashes(leaves[i], tree.leaves[i])) {
+            corrupt_chunks.push_back(i);
+        }
+    }
+    return corrupt_chunks.empty();
+}
+
+std::string HashUtils::computeTreeRoot(const std::vector<std::string>& leaves) {
+    if (leaves.empty()) {
+        return "";
+    }
+    
+    std::vector<std::vector<uint8_t>> level;
+    level.reserve(leaves.size());
+    for (const std::string& leaf : leaves) {
+        level.push_back(hexToBytes(leaf));
+        if (level.back().size() != SHA256::DIGESTSIZE) {
+            return "";
+        }
+    }
+    
+    SHA256 hash;
+    while (level.size() > 1) {
+        std::vector<std::vector<uint8_t>> parents((level.size() + 1) / 2);
+        for (size_t i = 0; i + 1 < level.size(); i += 2) {
+            std::vector<uint8_t>& parent = parents[i / 2];
+            parent.resize(SHA256::DIGESTSIZE);
+            hash.Update(&kTreeNodePrefix, 1);
+            hash.Update(level[i].data(), level[i].size());
+            hash.Update(level[i + 1].data(), level[i + 1].size());
+            hash.Final(parent.data());
+        }
+        if (level.size() % 2 != 0) {
+            parents.back().swap(level.back());
+        }
+        level.swap(parents);
+    }
+    return bytesToHex(level[0]);
+}
+
+struct HashUtils::TreeHasher::State {
+    explicit State(size_t size) : chunk_size(size), filled(0), started(false) {}
+    
+    SHA256 leaf;
+    size_t chunk_size;
+    size_t filled;   // Bytes of the current chunk hashed so far
+    bool started;    // Whether the current leaf has its prefix yet
+    std::vector<std::string> leaves;
+};
+
+HashUtils::TreeHasher::TreeHasher(size_t chunk_size)
+    : state_(new State(chunk_size == 0 ? kTreeChunkSize : chunk_size)) {
+}
+
+HashUtils::TreeHasher::~TreeHasher() {
+}
+
+void HashUtils::TreeHasher::update(const uint8_t* data, size_t size) {
+    State& state = *state_;
+    while (size > 0) {
+        if (!state.started) {
+            state.leaf.Update(&kTreeLeafPrefix, 1);
+            state.started = true;
+        }
+        size_t take = std::min(size, state.chunk_size - state.filled);
+        state.leaf.Update(data, take);
+        state.filled += take;
+        data += take;
+        size -= take;
+        if (state.filled == state.chunk_size) {
+            state.leaves.push_back(finalHex(state.leaf));
+            state.filled = 0;
+            state.started = false;
+        }
+    }
+}
+
+void HashUtils::TreeHasher::update(const std::vector<uint8_t>& data) {
+    update(data.data(), data.size());
+}
+
+const std::vector<std::string>& HashUtils::TreeHasher::leaves() const {
+    return state_->leaves;
+}
+
+bool HashUtils::TreeHasher::finish(TreeHash& tree) {
+    State& state = *state_;
+    // As in computeTreeLeaves, an empty message still has one (empty) leaf
+    if (state.started || state.leaves.empty()) {
+        if (!state.started) {
+            state.leaf.Update(&kTreeLeafPrefix, 1);
+        }
+        state.leaves.push_back(finalHex(state.leaf));
+        state.filled = 0;
+        state.started = false;
+    }
+    tree.chunk_size = state.chunk_size;
+    tree.leaves.swap(state.leaves);
+    state.leaves.clear();
+    tree.root = computeTreeRoot(tree.leaves);
+    return !tree.root.empty();
+}
+
+std::string HashUtils::serializeTreeHash(const TreeHash& tree) {
+    std::string text = std::to_string(tree.chunk_size) + ":" + tree.root + ":";
+    for (size_t i = 0; i < tree.leaves.size(); i++) {
+        if (i > 0) {
+            text += ',';
+        }
+        text += tree.leaves[i];
+    }
+    return text;
+}
+
+bool HashUtils::parseTreeHash(const std::string& text, TreeHash& tree) {
+    size_t first = text.find(':');
+    size_t second = first == std::string::npos ? first : text.find(':', first + 1);
+    if (second == std::string::npos) {
+        return false;
+    }
+    
+    try {
+        size_t used = 0;
+        unsigned long long chunk_size = std::stoull(text.substr(0, first), &used);
+        if (used != first || chunk_size == 0) {
+            return false;
+        }
+        tree.chunk_size = static_cast<size_t>(chunk_size);
+    } catch (const std::exception&) {
+        return false;
+    }
+    tree.root = text.substr(first + 1, second - first - 1);
+    
+    tree.leaves.clear();
+    std::istringstream leaves(text.substr(second + 1));
+    std::string leaf;
+    while (std::getline(leaves, leaf, ',')) {
+        if (leaf.size() != SHA256::DIGESTSIZE * 2) {
+            return false;
+        }
+        tree.leaves.push_back(leaf);
+    }
+    return !tree.leaves.empty() && tree.root.size() == SHA256::DIGESTSIZE * 2;
+}
+
+std::string HashUtils::computeFileSHA256(const std::string& file_path) {
+    return computeFileHash(file_path, "SHA256");
+}
+
+std::string HashUtils::computeFileSHA1(const std::string& file_path) {
+    return computeFileHash(file_path, "SHA1");
+}
+
+std::string HashUtils::computeFileMD5(const std::string& file_path) {
+    return computeFileHash(file_path, "MD5");
+}
+
+std::vector<std::string> HashUtils::computeSHA256Batch(const std::vector<std::vector<uint8_t>>& inputs,
+                                                      size_t threads) {
+    std::vector<std::string> digests(inputs.size());
+    std::vector<size_t> sizes(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        sizes[i] = inputs[i].size();
+    }
+    
+    runBatch(groupBatch(sizes), sizes, threads, [&inputs, &digests](const BatchGroup& group) {
+        const uint8_t* data[MultiBufferSHA256::kLanes];
+        size_t group_sizes[MultiBufferSHA256::kLanes];
+        for (size_t lane = 0; lane < group.size(); lane++) {
+            data[lane] = inputs[group[lane]].data();
+            group_sizes[lane] = inputs[group[lane]].size();
+        }
+        hashGroup(group, data, group_sizes, digests);
+    });
+    return digests;
+}
+
+std::vector<std::string> HashUtils::computeFileSHA256Batch(const std::vector<std::string>& file_paths,
+                                                          size_t threads) {
+    std::vector<std::string> digests(file_paths.size());
+    try {
+        // Sizes only steer grouping; a missing file shows up when it is read
+        std::vector<size_t> sizes(file_paths.size());
+        for (size_t i = 0; i < file_paths.size(); i++) {
+            struct stat info;
+            sizes[i] = stat(file_paths[i].c_str(), &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+        }
+        
+        // Files up to one read buffer are read whole, which for key-package
+        // sized files is cheaper than mapping them; larger ones are mapped
+        runBatch(groupBatch(sizes), sizes, threads, [&file_paths, &sizes, &digests](const BatchGroup& group) {
+            FileView views[MultiBufferSHA256::kLanes];
+            std::vector<uint8_t> contents[MultiBufferSHA256::kLanes];
+            const uint8_t* data[MultiBufferSHA256::kLanes];
+            size_t group_sizes[MultiBufferSHA256::kLanes];
+            BatchGroup readable;
+            for (size_t index : group) {
+                size_t lane = readable.size();
+                bool opened;
+                if (sizes[index] <= kFileBufferSize) {
+                    std::ifstream file(file_paths[index], std::ios::binary);
+                    contents[lane].resize(sizes[index]);
+                    opened = file && file.read(reinterpret_cast<char*>(contents[lane].data()), sizes[index]);
+                    data[lane] = contents[lane].data();
+                    group_sizes[lane] = contents[lane].size();
+                } else {
+                    opened = views[lane].open(file_paths[index]);
+                    data[lane] = views[lane].data();
+                    group_sizes[lane] = views[lane].size();
+                }
+                if (!opened) {
+                    std::cerr << "Cannot read file for hashing: " << file_paths[index] << std::endl;
+                    continue;
+                }
+                readable.push_back(index);
+            }
+            hashGroup(readable, data, group_sizes, digests);
+        });
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Batch hashing error: " << e.what() << std::endl;
+        return std::vector<std::string>(file_paths.size());
+    }
+    return digests;
+}
+
+std::string HashUtils::computeSHA256(const std::vector<uint8_t>& data) {
+    return computeHash(data, "SHA256");
+}
+
+std::string HashUtils::computeSHA256(const std::string& data) {
+    SHA256 hash;
+    hash.Update(reinterpret_cast<const byte*>(data.data()), data.size());
+    return finalHex(hash);
+}
+
+std::string HashUtils::computeSHA1(const std::vector<uint8_t>& data) {
+    return computeHash(data, "SHA1");
+}
+
+std::string HashUtils::computeMD5(const std::vector<uint8_t>& data) {
+    return computeHash(data, "MD5");
+}
+
+std::string HashUtils::computeHMACSHA256(const std::vector<uint8_t>& data,
+                                         const std::vector<uint8_t>& key) {
+    return computeHMAC(data, key, "SHA256");
+}
+
+std::string HashUtils::computeHMACSHA1(const std::vector<uint8_t>& data,
+                                       const std::vector<uint8_t>& key) {
+    return computeHMAC(data, key, "SHA1");
+}
+
+std::string HashUtils::hashPassword(const std::string& password,
+                                    const std::vector<uint8_t>& salt,
+                                    int iterations) {
+    try {
+        if (iterations <= 0) {
+            std::cerr << "Invalid PBKDF2 iteration count: " << iterations << std::endl;
+            return "";
+        }
+        
+        std::vector<uint8_t> derived(SHA256::DIGESTSIZE);
+        PKCS5_PBKDF2_HMAC<SHA256> pbkdf2;
+        pbkdf2.DeriveKey(derived.data(), derived.size(), 0,
+                         reinterpret_cast<const byte*>(password.data()), password.size(),
+                         salt.data(), salt.size(), static_cast<unsigned int>(iterations));
+        return bytesToHex(derived);
+    
+    } catch (const std::exception& e) {
+        std::cerr << "Password hashing error: " << e.what() << std::endl;
+        return "";
+    }
+}
+
+bool HashUtils::verifyPassword(const std::string& password,
+                               const std::string& stored_hash,
+                               const std::vector<uint8_t>& salt,
+                               int iterations) {
+    std::string computed = hashPassword(password, salt, iterations);
+    return !computed.empty() && compareHashes(computed, stored_hash);
+}
+
+std::vector<uint8_t> HashUtils::generateRandomSalt(size_t length) {
+    std::vector<uint8_t> salt(length);
+    AutoSeededRandomPool rng;
+    rng.GenerateBlock(salt.data(), salt.size());
+    return salt;
+}
+
+std::string HashUtils::bytesToHex(const std::vector<uint8_t>& bytes) {
+    return Encoding::toHex(bytes);
+}
+
+std::vector<uint8_t> HashUtils::hexToBytes(const std::string& hex) {
+    return Encoding::fromHex(hex);
+}
+
+bool HashUtils::compareHashes(const std::string& hash1, const std::string& hash2) {
+    // Hex case is not significant; the comparison itself runs in constant
+    // time so a mismatch position does not leak through timing
+    if (hash1.size() != hash2.size()) {
+        return false;
+    }
+    std::string a(hash1), b(hash2);
+    std::transform(a.begin(), a.end(), a.begin(), [](unsigned char c) { return std::tolower(c); });
+    std::transform(b.begin(), b.end(), b.begin(), [](unsigned char c) { return std::tolower(c); });
+    return VerifyBufsEqual(reinterpret_cast<const byte*>(a.data()),
+                           reinterpret_cast<const byte*>(b.data()), a.size());
+}
+
+void HashUtils::setProgressCallback(ProgressCallback callback) {
+    progress_callback_ = callback;
+}
+
+std::string HashUtils::computeFileHash(const std::string& file_path, const std::string& algorithm) {
+    try {
+        std::unique_ptr<HashTransformation> hash = createHash(algorithm);
+        if (!hash) {
+            std::cerr << "Unsupported hash algorithm: " << algorithm << std::endl;
+            return "";
+        }
+        
+        std::ifstream file(file_path, std::ios::binary | std::ios::ate);
+        if (!file) {
+            std::cerr << "Cannot open file for hashing: " << file_path << std::endl;
+            return "";
+        }
+        size_t total_bytes = static_cast<size_t>(file.tellg());
+        file.seekg(0, std::ios::beg);
+        
+        // Small files (key packages) need no more than their own size
+        std::vector<uint8_t> buffer(std::max<size_t>(1, std::min(kFileBufferSize, total_bytes)));
+        size_t bytes_processed = 0;
+        while (file) {
+            file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+            size_t got = static_cast<size_t>(file.gcount());
+            if (got == 0) {
+                break;
+            }
+            hash->Update(buffer.data(), got);
+            bytes_processed += got;
+            if (progress_callback_) {
+                progress_callback_(bytes_processed, total_bytes);
+            }
+        }
+        if (file.bad()) {
+            std::cerr << "Failed to read file for hashing: " << file_path << std::endl;
+            return "";
+        }
+        
+        return finalHex(*hash);
+    
+    } catch (const std::exception& e) {
+        std::cerr << "Hashing error: " << e.what() << std::endl;
+        return "";
+    }
+}
+
+std::string HashUtils::computeHash(const std::vector<uint8_t>& data, const std::string& algorithm) {
+    std::unique_ptr<HashTransformation> hash = createHash(algorithm);
+    if (!hash) {
+        std::cerr << "Unsupported hash algorithm: " << algorithm << std::endl;
+        return "";
+    }
+    hash->Update(data.data(), data.size());
+    return finalHex(*hash);
+}
+
+std::string HashUtils::computeHMAC(const std::vector<uint8_t>& data,
+                                   const std::vector<uint8_t>& key,
+                                   const std::string& algorithm) {
+    try {
+        std::unique_ptr<HashTransformation> mac;
+        if (algorithm == "SHA256") {
+            mac.reset(new HMAC<SHA256>(key.data(), key.size()));
+        } else if (algorithm == "SHA1") {
+            mac.reset(new HMAC<SHA1>(key.data(), key.size()));
+        } else {
+            std::cerr << "Unsupported HMAC algorithm: " << algorithm << std::endl;
+            return "";
+        }
+        mac->Update(data.data(), data.size());
+        return finalHex(*mac);
+    
+    } catch (const std::exception& e) {
+        std::cerr << "HMAC error: " << e.what() << std::endl;
+        return "";
+    }
+}
+
+bool HashUtils::computeTreeLeaves(const std::string& file_path, size_t chunk_size, size_t threads,
+                                  std::vector<std::string>& leaves) {
+    try {
+        leaves.clear();
+        if (chunk_size == 0) {
+            std::cerr << "Invalid tree hash chunk size" << std::endl;
+            return false;
+        }
+        
+        FileView view;
+        if (!view.open(file_path)) {
+            std::cerr << "Cannot open file for hashing: " << file_path << std::endl;
+            return false;
+        }
+        
+        // An empty file still has one (empty) leaf, so every tree has a root
+        const size_t total_bytes = view.size();
+        const size_t chunk_count = std::max<size_t>(1, (total_bytes + chunk_size - 1) / chunk_size);
+        leaves.resize(chunk_count);
+        
+        if (threads == 0) {
+            threads = ThreadPool::defaultThreadCount();
+        }
+        threads = std::min(threads, chunk_count);
+        
+        // Leaves are hashed straight out of the mapped file; progress is
+        // reported as they complete in order
+        std::unique_ptr<ThreadPool> pool(threads > 1 ? new ThreadPool(threads) : nullptr);
+        std::vector<std::future<void>> pending;
+        pending.reserve(chunk_count);
+        for (size_t i = 0; i < chunk_count; i++) {
+            const uint8_t* begin = view.data() + std::min(i * chunk_size, total_bytes);
+            size_t size = std::min(chunk_size, total_bytes - std::min(i * chunk_size, total_bytes));
+            std::string* leaf = &leaves[i];
+            auto task = [begin, size, leaf]() { *leaf = treeLeaf(begin, size); };
+            pending.push_back(pool ? pool->submit(task) : std::async(std::launch::deferred, task));
+        }
+        
+        size_t bytes_processed = 0;
+        for (size_t i = 0; i < chunk_count; i++) {
+            pending[i].get();
+            bytes_processed = std::min(total_bytes, bytes_processed + chunk_size);
+            if (progress_callback_) {
+                progress_callback_(bytes_processed, total_bytes);
+            }
+        }
+        return true;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Tree hashing error: " << e.what() << std::endl;
+        leaves.clear();
+        return false;
+    }
+}
@@ -1,68 +1,427 @@
 #include "huffman.h"
+#include "thread_pool.h"
+#include "lz77.h"
+#include "file_view.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <bitset>
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <cstring>
+#include <cmath>
+#include <zlib.h>
+
+namespace {
+
+const uint8_t kContainerMagic[4] = {'T', 'C', 'H', 'F'};
+const uint8_t kIndexMagic[4] = {'T', 'C', 'H', 'I'};
+const uint8_t kContainerVersion = 5;
+
+// First payload byte of each frame
+const uint8_t kBlockStored = 0;
+const uint8_t kBlockHuffman = 1;
+const uint8_t kBlockLz77 = 2;
+const size_t kContainerHeaderSize = 20;
+const size_t kFrameHeaderSize = 12;
+const size_t kIndexEntrySize = 12;
+const size_t kFooterSize = 16;
+
+// Entropy probe: blocks whose sampled entropy is at least this many bits per
+// byte (already compressed media, archives) are stored without a full pass
+const size_t kProbeWindowSize = 4096;
+const int kProbeWindows = 8;
+const double kStoreEntropyBits = 7.8;
+
+void putU32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void putU64(std::vector<uint8_t>& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void patchU32(std::vector<uint8_t>& out, size_t pos, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[pos + i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint32_t getU32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t getU64(const uint8_t* p) {
+    return static_cast<uint64_t>(getU32(p)) | (static_cast<uint64_t>(getU32(p + 4)) << 32);
+}
+
+// CRC-32 of a block's raw bytes, checked after decoding
+uint32_t blockChecksum(const uint8_t* data, size_t size) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    return static_cast<uint32_t>(crc32(crc, data, static_cast<uInt>(size)));
+}
+
+bool isContainer(const uint8_t* data, size_t size) {
+    return size >= sizeof(kContainerMagic) &&
+           std::equal(kContainerMagic, kContainerMagic + sizeof(kContainerMagic), data);
+}
+
+// Huffman payloads are only written when smaller than a stored block, so no
+// payload exceeds the block plus its type byte
+size_t maxPayloadSize(size_t block_size) {
+    return block_size + 1;
+}
+
+bool readExact(std::istream& in, uint8_t* dst, size_t size) {
+    in.read(reinterpret_cast<char*>(dst), size);
+    return static_cast<size_t>(in.gcount()) == size;
+}
+
+bool writeBytes(std::ostream& out, const std::vector<uint8_t>& bytes) {
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return !out.fail();
+}
+
+// Byte histogram. Runs of equal bytes would serialize on one counter's
+// load-increment-store, so consecutive bytes go to separate sub-tables that
+// are summed at the end. Input is read eight bytes per load.
+void countBytes(const uint8_t* data, size_t size, uint32_t counts[256]) {
+    uint32_t tables[4][256] = {{0}};
+    size_t i = 0;
+    
+    for (; i + 16 <= size; i += 16) {
+        uint64_t lo, hi;
+        std::memcpy(&lo, data + i, sizeof(lo));
+        std::memcpy(&hi, data + i + 8, sizeof(hi));
+        tables[0][lo & 0xFF]++;
+        tables[1][(lo >> 8) & 0xFF]++;
+        tables[2][(lo >> 16) & 0xFF]++;
+        tables[3][(lo >> 24) & 0xFF]++;
+        tables[0][(lo >> 32) & 0xFF]++;
+        tables[1][(lo >> 40) & 0xFF]++;
+        tables[2][(lo >> 48) & 0xFF]++;
+        tables[3][lo >> 56]++;
+        tables[0][hi & 0xFF]++;
+        tables[1][(hi >> 8) & 0xFF]++;
+        tables[2][(hi >> 16) & 0xFF]++;
+        tables[3][(hi >> 24) & 0xFF]++;
+        tables[0][(hi >> 32) & 0xFF]++;
+        tables[1][(hi >> 40) & 0xFF]++;
+        tables[2][(hi >> 48) & 0xFF]++;
+        tables[3][hi >> 56]++;
+    }
+    for (; i < size; i++) {
+        tables[0][data[i]]++;
+    }
+    
+    for (int symbol = 0; symbol < 256; symbol++) {
+        counts[symbol] = tables[0][symbol] + tables[1][symbol] +
+                         tables[2][symbol] + tables[3][symbol];
+    }
+}
+
+// Order-0 entropy in bits per byte, estimated from kProbeWindows evenly
+// spaced windows. Small blocks are counted in full.
+double sampledEntropy(const uint8_t* data, size_t size) {
+    uint32_t counts[256] = {0};
+    size_t sampled = 0;
+    
+    if (size <= kProbeWindowSize * kProbeWindows) {
+        countBytes(data, size, counts);
+        sampled = size;
+    } else {
+        const size_t stride = (size - kProbeWindowSize) / (kProbeWindows - 1);
+        uint32_t window[256];
+        for (int w = 0; w < kProbeWindows; w++) {
+            countBytes(data + w * stride, kProbeWindowSize, window);
+            for (int symbol = 0; symbol < 256; symbol++) {
+                counts[symbol] += window[symbol];
+            }
+        }
+        sampled = kProbeWindowSize * kProbeWindows;
+    }
+    
+    double entropy = 0.0;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        if (counts[symbol] > 0) {
+            double p = static_cast<double>(counts[symbol]) / sampled;
+            entropy -= p * std::log2(p);
+        }
+    }
+    return entropy;
+}
+
+// Replaces everything after the frame header with a stored payload
+void writeStoredPayload(std::vector<uint8_t>& frame, size_t frame_start,
+                        const uint8_t* data, size_t size) {
+    frame.resize(frame_start + kFrameHeaderSize);
+    frame.push_back(kBlockStored);
+    frame.insert(frame.end(), data, data + size);
+    patchU32(frame, frame_start + 4, static_cast<uint32_t>(size + 1));
+}
+
+} // namespace
 
 HuffmanCompressor::HuffmanCompressor() 
-    : root_(nullptr), original_size_(0), compressed_size_(0) {
+    : frequency_table_(), original_size_(0), compressed_size_(0),
+      block_size_(kDefaultBlockSize), thread_count_(0),
+      max_code_length_(kDefaultMaxCodeLength), entropy_probe_(true),
+      stored_blocks_(0), codec_(CodecId::Huffman),
+      match_chain_(Lz77Matcher::kDefaultMaxChain) {
 }
 
 HuffmanCompressor::~HuffmanCompressor() {
-    // Smart pointers handle cleanup
+}
+
+void HuffmanCompressor::setBlockSize(size_t block_size) {
+    if (block_size == 0 || block_size > kMaxBlockSize) {
+        block_size = kDefaultBlockSize;
+    }
+    block_size_ = block_size;
+}
+
+size_t HuffmanCompressor::getBlockSize() const {
+    return block_size_;
+}
+
+uint64_t HuffmanCompressor::maxContainerSize(uint64_t original_size, size_t block_size) {
+    // Header, each block as a stored frame (frame header, block type,
+    // raw bytes), the terminating frame, one index entry per block and
+    // the footer
+    uint64_t blocks = original_size / block_size + (original_size % block_size != 0);
+    return kContainerHeaderSize + blocks * (kFrameHeaderSize + 1) + original_size +
+           kFrameHeaderSize + blocks * kIndexEntrySize + kFooterSize;
+}
+
+void HuffmanCompressor::setThreadCount(size_t thread_count) {
+    thread_count_ = thread_count;
+}
+
+size_t HuffmanCompressor::getThreadCount() const {
+    return thread_count_ > 0 ? thread_count_ : ThreadPool::defaultThreadCount();
+}
+
+void HuffmanCompressor::setMaxCodeLength(int max_code_length) {
+    max_code_length_ = std::max(kMinCodeLengthLimit,
+                                std::min(max_code_length, HuffmanDecodeTable::kMaxCodeLength));
+}
+
+int HuffmanCompressor::getMaxCodeLength() const {
+    return max_code_length_;
+}
+
+void HuffmanCompressor::setEntropyProbe(bool enabled) {
+    entropy_probe_ = enabled;
+}
+
+bool HuffmanCompressor::getEntropyProbe() const {
+    return entropy_probe_;
+}
+
+size_t HuffmanCompressor::getStoredBlockCount() const {
+    return stored_blocks_;
+}
+
+void HuffmanCompressor::setCodec(CodecId codec) {
+    codec_ = codec;
+}
+
+CodecId HuffmanCompressor::getCodec() const {
+    return codec_;
+}
+
+void HuffmanCompressor::setMatchChain(int max_chain) {
+    match_chain_ = std::max(1, max_chain);
+}
+
+int HuffmanCompressor::getMatchChain() const {
+    return match_chain_;
+}
+
+bool HuffmanCompressor::readCodec(const std::string& input_file, CodecId& codec) {
+    std::ifstream in_file(input_file, std::ios::binary);
+    if (!in_file) {
+        std::cerr << "Cannot open input file: " << input_file << std::endl;
+        return false;
+    }
+    
+    uint8_t header[kContainerHeaderSize];
+    in_file.read(reinterpret_cast<char*>(header), sizeof(header));
+    size_t header_bytes = static_cast<size_t>(in_file.gcount());
+    if (header_bytes == 0) {
+        return false;
+    }
+    if (!isContainer(header, header_bytes)) {
+        codec = CodecId::Huffman; // Single-block file from before the container format
+        return true;
+    }
+    if (header_bytes != kContainerHeaderSize || header[4] != kContainerVersion ||
+        header[5] > static_cast<uint8_t>(CodecId::Lz77Huffman)) {
+        return false;
+    }
+    codec = static_cast<CodecId>(header[5]);
+    return true;
+}
+
+std::unique_ptr<ThreadPool> HuffmanCompressor::createPool(size_t block_count) const {
+    size_t threads = std::min(getThreadCount(), block_count);
+    if (threads <= 1) {
+        return nullptr;
+    }
+    return std::unique_ptr<ThreadPool>(new ThreadPool(threads));
+}
+
+std::future<std::vector<uint8_t>> HuffmanCompressor::submitCompress(ThreadPool* pool,
+                                                                   const uint8_t* data,
+                                                                   size_t size) const {
+    // Each block gets its own compressor so workers share no code tables
+    int max_code_length = max_code_length_;
+    bool entropy_probe = entropy_probe_;
+    CodecId codec = codec_;
+    int match_chain = match_chain_;
+    auto task = [data, size, max_code_length, entropy_probe, codec, match_chain]() {
+        HuffmanCompressor worker;
+        worker.setMaxCodeLength(max_code_length);
+        worker.setEntropyProbe(entropy_probe);
+        worker.setCodec(codec);
+        worker.setMatchChain(match_chain);
+        std::vector<uint8_t> frame;
+        if (!worker.compressBlock(data, size, frame)) {
+            frame.clear();
+        }
+        return frame;
+    };
+    
+    if (pool) {
+        return pool->submit(task);
+    }
+    return std::async(std::launch::deferred, task);
+}
+
+std::future<bool> HuffmanCompressor::submitDecompress(ThreadPool* pool,
+                                                     const uint8_t* payload,
+                                                     size_t payload_size,
+                                                     uint8_t* output,
+                                                     size_t raw_size,
+                                                     uint32_t checksum) {
+    auto task = [payload, payload_size, output, raw_size, checksum]() {
+        HuffmanCompressor worker;
+        return worker.decompressBlock(payload, payload_size, output, raw_size, checksum);
+    };
+    
+    if (pool) {
+        return pool->submit(task);
+    }
+    return std::async(std::launch::deferred, task);
 }
 
 bool HuffmanCompressor::compressFile(const std::string& input_file, const std::string& output_file) {
+    std::ofstream out_file(output_file, std::ios::binary);
+    if (!out_file) {
+        std::cerr << "Cannot create output file: " << output_file << std::endl;
+        return false;
+    }
+    
+    auto write_piece = [&out_file](std::vector<uint8_t>&& piece) {
+        if (!writeBytes(out_file, piece)) {
+            std::cerr << "Failed to write compressed file" << std::endl;
+            return false;
+        }
+        return true;
+    };
+    if (!compressFile(input_file, write_piece)) {
+        return false;
+    }
+    
+    out_file.close();
+    if (out_file.fail()) {
+        std::cerr << "Failed to write compressed file" << std::endl;
+        return false;
+    }
+    
+    std::cout << "Compression successful: " << input_file << " -> " << output_file << std::endl;
+    std::cout << "Original size: " << original_size_ << " bytes" << std::endl;
+    std::cout << "Compressed size: " << compressed_size_ << " bytes" << std::endl;
+    std::cout << "Compression ratio: " << getCompressionRatio() << std::endl;
+    std::cout << "Stored blocks: " << stored_blocks_ << " of "
+              << (original_size_ + block_size_ - 1) / block_size_ << std::endl;
+    return true;
+}
+
+bool HuffmanCompressor::compressFile(const std::string& input_file, const ByteSink& sink) {
     try {
-        // Read input file
-        std::ifstream in_file(input_file, std::ios::binary);
-        if (!in_file) {
-            std::cerr << "Cannot open input file: " << input_file << std::endl;
+        FileView input;
+        if (!input.open(input_file)) {
             return false;
         }
         
-        std::vector<uint8_t> input_data((std::istreambuf_iterator<char>(in_file)),
-                                      std::istreambuf_iterator<char>());
-        in_file.close();
-        
-        if (input_data.empty()) {
+        if (input.empty()) {
             std::cerr << "Input file is empty: " << input_file << std::endl;
             return false;
         }
         
-        original_size_ = input_data.size();
+        size_t input_size = input.size();
         
-        // Compress data
-        std::vector<uint8_t> compressed_data;
-        if (!compressData(input_data, compressed_data)) {
-            std::cerr << "Compression failed" << std::endl;
-            return false;
-        }
+        // Blocks are compressed concurrently, straight out of the file view,
+        // but handed to the sink in input order. At most `window` frames are
+        // held at a time. The pool is declared last so an early return joins
+        // its workers before the view they read is unmapped.
+        std::deque<size_t> block_sizes;
+        std::deque<std::future<std::vector<uint8_t>>> pending;
+        std::unique_ptr<ThreadPool> pool = createPool((input_size + block_size_ - 1) / block_size_);
+        const size_t window = pool ? pool->size() * 2 : 1;
         
-        compressed_size_ = compressed_data.size();
+        std::vector<uint8_t> frame;
+        std::vector<HuffmanBlockIndexEntry> index;
         
-        // Write compressed file
-        std::ofstream out_file(output_file, std::ios::binary);
-        if (!out_file) {
-            std::cerr << "Cannot create output file: " << output_file << std::endl;
+        writeContainerHeader(input_size, frame);
+        uint64_t offset = frame.size();
+        if (!sink(std::move(frame))) {
             return false;
         }
+        original_size_ = 0;
+        stored_blocks_ = 0;
         
-        out_file.write(reinterpret_cast<const char*>(compressed_data.data()), 
-                      compressed_data.size());
-        out_file.close();
-        
-        if (out_file.fail()) {
-            std::cerr << "Failed to write compressed file" << std::endl;
-            return false;
+        size_t next_offset = 0;
+        while (next_offset < input_size || !pending.empty()) {
+            if (next_offset < input_size && pending.size() < window) {
+                size_t block_bytes = std::min(block_size_, input_size - next_offset);
+                block_sizes.push_back(block_bytes);
+                pending.push_back(submitCompress(pool.get(), input.data() + next_offset, block_bytes));
+                next_offset += block_bytes;
+                continue;
+            }
+            
+            frame = pending.front().get();
+            size_t block_bytes = block_sizes.front();
+            pending.pop_front();
+            block_sizes.pop_front();
+            
+            if (frame.empty()) {
+                std::cerr << "Compression failed" << std::endl;
+                return false;
+            }
+            
+            index.push_back({offset, static_cast<uint32_t>(block_bytes)});
+            offset += frame.size();
+            original_size_ += block_bytes;
+            if (frame[kFrameHeaderSize] == kBlockStored) {
+                stored_blocks_++;
+            }
+            if (!sink(std::move(frame))) {
+                return false;
+            }
         }
         
-        std::cout << "Compression successful: " << input_file << " -> " << output_file << std::endl;
-        std::cout << "Original size: " << original_size_ << " bytes" << std::endl;
-        std::cout << "Compressed size: " << compressed_size_ << " bytes" << std::endl;
-        std::cout << "Compression ratio: " << getCompressionRatio() << std::endl;
-        
-        return true;
+        frame.clear();
+        writeContainerTrailer(index, offset, frame);
+        compressed_size_ = offset + frame.size();
+        return sink(std::move(frame));
         
     } catch (const std::exception& e) {
         std::cerr << "Compression error: " << e.what() << std::endl;
@@ -72,47 +431,155 @@ bool HuffmanCompressor::compressFile(const std::string& input_file, const std::s
 
 bool HuffmanCompressor::decompressFile(const std::string& input_file, const std::string& output_file) {
     try {
-        // Read compressed file
         std::ifstream in_file(input_file, std::ios::binary);
         if (!in_file) {
             std::cerr << "Cannot open input file: " << input_file << std::endl;
             return false;
         }
         
-        std::vector<uint8_t> compressed_data((std::istreambuf_iterator<char>(in_file)),
-                                           std::istreambuf_iterator<char>());
-        in_file.close();
+        uint8_t header[kContainerHeaderSize];
+        in_file.read(reinterpret_cast<char*>(header), sizeof(header));
+        size_t header_bytes = static_cast<size_t>(in_file.gcount());
         
-        if (compressed_data.empty()) {
+        if (header_bytes == 0) {
             std::cerr << "Compressed file is empty: " << input_file << std::endl;
             return false;
         }
         
-        // Decompress data
-        std::vector<uint8_t> decompressed_data;
-        if (!decompressData(compressed_data, decompressed_data)) {
-            std::cerr << "Decompression failed" << std::endl;
+        if (!isContainer(header, header_bytes)) {
+            // Single-block file from before the container format
+            in_file.clear();
+            in_file.seekg(0, std::ios::beg);
+            std::vector<uint8_t> compressed_data((std::istreambuf_iterator<char>(in_file)),
+                                               std::istreambuf_iterator<char>());
+            std::vector<uint8_t> decompressed_data;
+            if (!decompressLegacy(compressed_data.data(), compressed_data.size(), decompressed_data)) {
+                std::cerr << "Decompression failed" << std::endl;
+                return false;
+            }
+            
+            std::ofstream out_file(output_file, std::ios::binary);
+            if (!out_file || !writeBytes(out_file, decompressed_data)) {
+                std::cerr << "Failed to write decompressed file" << std::endl;
+                return false;
+            }
+            
+            std::cout << "Decompression successful: " << input_file << " -> " << output_file << std::endl;
+            std::cout << "Decompressed size: " << decompressed_data.size() << " bytes" << std::endl;
+            return true;
+        }
+        
+        size_t block_size = 0;
+        uint64_t original_size = 0;
+        if (header_bytes != kContainerHeaderSize ||
+            !readContainerHeader(header, block_size, original_size)) {
+            std::cerr << "Invalid compressed file header: " << input_file << std::endl;
             return false;
         }
         
-        // Write decompressed file
         std::ofstream out_file(output_file, std::ios::binary);
         if (!out_file) {
             std::cerr << "Cannot create output file: " << output_file << std::endl;
             return false;
         }
         
-        out_file.write(reinterpret_cast<const char*>(decompressed_data.data()), 
-                      decompressed_data.size());
-        out_file.close();
+        // The footer's block count sizes the worker pool
+        size_t block_count = 1;
+        uint8_t footer[kFooterSize];
+        in_file.seekg(-static_cast<std::streamoff>(kFooterSize), std::ios::end);
+        if (readExact(in_file, footer, sizeof(footer)) &&
+            std::equal(kIndexMagic, kIndexMagic + sizeof(kIndexMagic), footer + 12)) {
+            block_count = getU32(footer);
+        }
+        in_file.clear();
+        in_file.seekg(kContainerHeaderSize, std::ios::beg);
+        
+        // Frames are decoded concurrently and written in container order
+        // (pool declared last, as in compressFile)
+        std::deque<std::vector<uint8_t>> payloads;
+        std::deque<std::vector<uint8_t>> blocks;
+        std::deque<std::future<bool>> pending;
+        std::unique_ptr<ThreadPool> pool = createPool(block_count);
+        const size_t window = pool ? pool->size() * 2 : 1;
+        uint64_t decompressed_size = 0;
+        bool input_done = false;
+        
+        // Where each frame was found, to check the index against
+        std::vector<HuffmanBlockIndexEntry> index;
+        uint64_t frame_offset = kContainerHeaderSize;
+        
+        while (!input_done || !pending.empty()) {
+            if (!input_done && pending.size() < window) {
+                uint8_t frame_header[kFrameHeaderSize];
+                if (!readExact(in_file, frame_header, sizeof(frame_header))) {
+                    std::cerr << "Truncated compressed file" << std::endl;
+                    return false;
+                }
+                
+                uint32_t raw_size = getU32(frame_header);
+                uint32_t payload_size = getU32(frame_header + 4);
+                uint32_t checksum = getU32(frame_header + 8);
+                if (raw_size == 0) {
+                    input_done = true; // End of block list, index follows
+                    continue;
+                }
+                if (raw_size > block_size || payload_size > maxPayloadSize(block_size)) {
+                    std::cerr << "Corrupt block header in compressed file" << std::endl;
+                    return false;
+                }
+                
+                std::vector<uint8_t> payload(payload_size);
+                if (!readExact(in_file, payload.data(), payload.size())) {
+                    std::cerr << "Truncated compressed file" << std::endl;
+                    return false;
+                }
+                payloads.push_back(std::move(payload));
+                blocks.emplace_back(raw_size);
+                pending.push_back(submitDecompress(pool.get(), payloads.back().data(), payload_size,
+                                                   blocks.back().data(), raw_size, checksum));
+                index.push_back({frame_offset, raw_size});
+                frame_offset += kFrameHeaderSize + payload_size;
+                continue;
+            }
+            
+            bool block_ok = pending.front().get();
+            pending.pop_front();
+            payloads.pop_front();
+            
+            if (!block_ok) {
+                std::cerr << "Decompression failed: corrupt block" << std::endl;
+                return false;
+            }
+            if (!writeBytes(out_file, blocks.front())) {
+                std::cerr << "Failed to write decompressed file" << std::endl;
+                return false;
+            }
+            decompressed_size += blocks.front().size();
+            blocks.pop_front();
+        }
+        
+        if (decompressed_size != original_size) {
+            std::cerr << "Decompressed size does not match header" << std::endl;
+            return false;
+        }
+        
+        // The terminating frame was read just before the index
+        std::vector<uint8_t> trailer(kFrameHeaderSize + index.size() * kIndexEntrySize + kFooterSize, 0);
+        if (!readExact(in_file, trailer.data() + kFrameHeaderSize, trailer.size() - kFrameHeaderSize) ||
+            in_file.peek() != std::ifstream::traits_type::eof() ||
+            !checkContainerTrailer(index, frame_offset, trailer.data(), trailer.size())) {
+            std::cerr << "Corrupt block index in compressed file" << std::endl;
+            return false;
+        }
         
+        out_file.close();
         if (out_file.fail()) {
             std::cerr << "Failed to write decompressed file" << std::endl;
             return false;
         }
         
         std::cout << "Decompression successful: " << input_file << " -> " << output_file << std::endl;
-        std::cout << "Decompressed size: " << decompressed_data.size() << " bytes" << std::endl;
+        std::cout << "Decompressed size: " << decompressed_size << " bytes" << std::endl;
         
         return true;
         
@@ -122,46 +589,501 @@ bool HuffmanCompressor::decompressFile(const std::string& input_file, const std:
     }
 }
 
-bool HuffmanCompressor::compressData(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) {
-    if (input.empty()) {
+// Parses frames as their bytes arrive and decodes them on the pool like
+// decompressFile, passing blocks to the sink in container order. The index
+// and footer are held until finish() checks them. Legacy single-block input
+// can only be decoded whole, so it is buffered until finish().
+class HuffmanCompressor::StreamDecoder : public StreamDecompressor {
+public:
+    StreamDecoder(const ByteSink& sink, size_t thread_count)
+        : sink_(sink), stage_(Stage::Header), pos_(0), block_size_(0), original_size_(0),
+          queued_size_(0), decoded_size_(0), frame_offset_(kContainerHeaderSize), window_(1), failed_(false) {
+        codec_.setThreadCount(thread_count);
+    }
+    
+    bool update(const uint8_t* data, size_t size) override {
+        if (failed_) {
+            return false;
+        }
+        buffer_.insert(buffer_.end(), data, data + size);
+        if (!parse()) {
+            return fail();
+        }
+        
+        // Drop consumed bytes once they are the larger part of the buffer
+        if (pos_ > 0 && pos_ >= buffer_.size() / 2) {
+            buffer_.erase(buffer_.begin(), buffer_.begin() + pos_);
+            pos_ = 0;
+        }
+        return true;
+    }
+    
+    bool finish() override {
+        if (failed_) {
+            return false;
+        }
+        failed_ = true; // No updates after finish
+        
+        if (stage_ == Stage::Legacy || (stage_ == Stage::Header && buffer_.size() - pos_ > 0)) {
+            std::vector<uint8_t> output;
+            if (!codec_.decompressLegacy(buffer_.data() + pos_, buffer_.size() - pos_, output)) {
+                std::cerr << "Decompression failed" << std::endl;
+                return false;
+            }
+            return sink_(std::move(output));
+        }
+        if (stage_ != Stage::Trailer) {
+            std::cerr << "Truncated compressed stream" << std::endl;
+            return false;
+        }
+        
+        while (!pending_.empty()) {
+            if (!drainOne()) {
+                return false;
+            }
+        }
+        
+        // The terminating frame is still at pos_, ahead of the index
+        if (!codec_.checkContainerTrailer(index_, frame_offset_, buffer_.data() + pos_, buffer_.size() - pos_)) {
+            std::cerr << "Corrupt block index in compressed stream" << std::endl;
+            return false;
+        }
+        if (decoded_size_ != original_size_) {
+            std::cerr << "Decompressed size does not match header" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    enum class Stage { Header, Frames, Trailer, Legacy };
+    
+    bool parse() {
+        while (true) {
+            const uint8_t* next = buffer_.data() + pos_;
+            size_t available = buffer_.size() - pos_;
+            
+            if (stage_ == Stage::Header) {
+                if (available < sizeof(kContainerMagic)) {
+                    return true;
+                }
+                if (!isContainer(next, available)) {
+                    stage_ = Stage::Legacy;
+                    return true;
+                }
+                if (available < kContainerHeaderSize) {
+                    return true;
+                }
+                if (!codec_.readContainerHeader(next, block_size_, original_size_)) {
+                    std::cerr << "Invalid compressed stream header" << std::endl;
+                    return false;
+                }
+                pos_ += kContainerHeaderSize;
+                pool_ = codec_.createPool((original_size_ + block_size_ - 1) / block_size_);
+                window_ = pool_ ? pool_->size() * 2 : 1;
+                stage_ = Stage::Frames;
+                continue;
+            }
+            
+            if (stage_ != Stage::Frames || available < kFrameHeaderSize) {
+                return true;
+            }
+            
+            uint32_t raw_size = getU32(next);
+            uint32_t payload_size = getU32(next + 4);
+            uint32_t checksum = getU32(next + 8);
+            if (raw_size == 0) {
+                stage_ = Stage::Trailer; // End of block list, index follows
+                return true;
+            }
+            if (raw_size > block_size_ || payload_size > maxPayloadSize(block_size_) ||
+                raw_size > original_size_ - queued_size_) {
+                std::cerr << "Corrupt block header in compressed stream" << std::endl;
+                return false;
+            }
+            if (available - kFrameHeaderSize < payload_size) {
+                return true;
+            }
+            
+            if (pending_.size() >= window_ && !drainOne()) {
+                return false;
+            }
+            const uint8_t* payload = next + kFrameHeaderSize;
+            payloads_.emplace_back(payload, payload + payload_size);
+            blocks_.emplace_back(raw_size);
+            pending_.push_back(submitDecompress(pool_.get(), payloads_.back().data(), payload_size,
+                                                blocks_.back().data(), raw_size, checksum));
+            index_.push_back({frame_offset_, raw_size});
+            pos_ += kFrameHeaderSize + payload_size;
+            frame_offset_ += kFrameHeaderSize + payload_size;
+            queued_size_ += raw_size;
+        }
+    }
+    
+    bool drainOne() {
+        bool block_ok = pending_.front().get();
+        pending_.pop_front();
+        payloads_.pop_front();
+        if (!block_ok) {
+            std::cerr << "Decompression failed: corrupt block" << std::endl;
+            return false;
+        }
+        decoded_size_ += blocks_.front().size();
+        std::vector<uint8_t> block = std::move(blocks_.front());
+        blocks_.pop_front();
+        return sink_(std::move(block));
+    }
+    
+    bool fail() {
+        failed_ = true;
         return false;
     }
     
-    // Build frequency table and Huffman tree
-    buildFrequencyTable(input);
-    buildHuffmanTree();
-    generateCodes(root_, "");
+    HuffmanCompressor codec_;
+    ByteSink sink_;
+    Stage stage_;
+    std::vector<uint8_t> buffer_;
+    size_t pos_;
+    size_t block_size_;
+    uint64_t original_size_;
+    uint64_t queued_size_;
+    uint64_t decoded_size_;
+    // Where each frame was found, to check the index against
+    std::vector<HuffmanBlockIndexEntry> index_;
+    uint64_t frame_offset_;
+    size_t window_;
+    bool failed_;
     
-    // Serialize Huffman tree and encode data
-    std::vector<uint8_t> tree_data = serializeTree();
-    std::vector<uint8_t> encoded_data = encodeData(input);
+    // Frames in flight; the pool is declared last so its workers are
+    // joined before the buffers they use are freed
+    std::deque<std::vector<uint8_t>> payloads_;
+    std::deque<std::vector<uint8_t>> blocks_;
+    std::deque<std::future<bool>> pending_;
+    std::unique_ptr<ThreadPool> pool_;
+};
+
+std::unique_ptr<StreamDecompressor> HuffmanCompressor::createStreamDecompressor(const ByteSink& sink) const {
+    return std::unique_ptr<StreamDecompressor>(new StreamDecoder(sink, thread_count_));
+}
+
+bool HuffmanCompressor::compressData(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) {
+    if (input.empty()) {
+        return false;
+    }
     
-    // Prepare output: [tree_size(4 bytes)][tree_data][encoded_data_size(4 bytes)][encoded_data]
     output.clear();
+    writeContainerHeader(input.size(), output);
     
-    // Write tree size
-    uint32_t tree_size = tree_data.size();
-    output.insert(output.end(), 
-                 reinterpret_cast<uint8_t*>(&tree_size),
-                 reinterpret_cast<uint8_t*>(&tree_size) + sizeof(tree_size));
+    const size_t block_count = (input.size() + block_size_ - 1) / block_size_;
+    std::unique_ptr<ThreadPool> pool = createPool(block_count);
+    std::vector<std::future<std::vector<uint8_t>>> frames;
+    frames.reserve(block_count);
     
-    // Write tree data
-    output.insert(output.end(), tree_data.begin(), tree_data.end());
+    for (size_t pos = 0; pos < input.size(); pos += block_size_) {
+        size_t block_bytes = std::min(block_size_, input.size() - pos);
+        frames.push_back(submitCompress(pool.get(), input.data() + pos, block_bytes));
+    }
     
-    // Write encoded data size (in bits)
-    uint32_t data_bits = encoded_data.size() * 8;
-    output.insert(output.end(),
-                 reinterpret_cast<uint8_t*>(&data_bits),
-                 reinterpret_cast<uint8_t*>(&data_bits) + sizeof(data_bits));
+    std::vector<HuffmanBlockIndexEntry> index;
+    bool ok = true;
+    stored_blocks_ = 0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        std::vector<uint8_t> frame = frames[i].get();
+        if (frame.empty()) {
+            ok = false;
+            continue;
+        }
+        if (frame[kFrameHeaderSize] == kBlockStored) {
+            stored_blocks_++;
+        }
+        size_t block_bytes = std::min(block_size_, input.size() - i * block_size_);
+        index.push_back({output.size(), static_cast<uint32_t>(block_bytes)});
+        output.insert(output.end(), frame.begin(), frame.end());
+    }
+    if (!ok) {
+        return false;
+    }
     
-    // Write encoded data
-    output.insert(output.end(), encoded_data.begin(), encoded_data.end());
+    writeContainerTrailer(index, output.size(), output);
     
+    original_size_ = input.size();
+    compressed_size_ = output.size();
     return true;
 }
 
 bool HuffmanCompressor::decompressData(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) {
-    if (input.size() < sizeof(uint32_t) * 2) {
+    if (!isContainer(input.data(), input.size())) {
+        return decompressLegacy(input.data(), input.size(), output);
+    }
+    
+    size_t block_size = 0;
+    uint64_t original_size = 0;
+    if (input.size() < kContainerHeaderSize ||
+        !readContainerHeader(input.data(), block_size, original_size)) {
+        return false;
+    }
+    
+    // Locate every frame first, then decode them concurrently straight into
+    // their place in the output
+    struct Frame {
+        size_t pos;
+        uint32_t payload_size;
+        uint32_t raw_size;
+        uint32_t checksum;
+        uint64_t output_pos;
+    };
+    std::vector<Frame> frames;
+    size_t pos = kContainerHeaderSize;
+    uint64_t total_size = 0;
+    
+    while (true) {
+        if (input.size() - pos < kFrameHeaderSize) {
+            return false;
+        }
+        uint32_t raw_size = getU32(input.data() + pos);
+        uint32_t payload_size = getU32(input.data() + pos + 4);
+        uint32_t checksum = getU32(input.data() + pos + 8);
+        pos += kFrameHeaderSize;
+        
+        if (raw_size == 0) {
+            break;
+        }
+        if (raw_size > block_size || payload_size > input.size() - pos ||
+            raw_size > original_size - total_size) {
+            return false;
+        }
+        
+        frames.push_back({pos, payload_size, raw_size, checksum, total_size});
+        pos += payload_size;
+        total_size += raw_size;
+    }
+    if (total_size != original_size || total_size == 0) {
+        return false;
+    }
+    
+    // The index must list exactly the frames just walked
+    std::vector<HuffmanBlockIndexEntry> index;
+    index.reserve(frames.size());
+    for (const auto& frame : frames) {
+        index.push_back({frame.pos - kFrameHeaderSize, frame.raw_size});
+    }
+    size_t terminator = pos - kFrameHeaderSize;
+    if (!checkContainerTrailer(index, terminator, input.data() + terminator, input.size() - terminator)) {
+        return false;
+    }
+    
+    output.assign(original_size, 0);
+    std::unique_ptr<ThreadPool> pool = createPool(frames.size());
+    std::vector<std::future<bool>> blocks;
+    blocks.reserve(frames.size());
+    for (const auto& frame : frames) {
+        blocks.push_back(submitDecompress(pool.get(), input.data() + frame.pos, frame.payload_size,
+                                          output.data() + frame.output_pos, frame.raw_size,
+                                          frame.checksum));
+    }
+    
+    bool ok = true;
+    for (auto& future : blocks) {
+        ok = future.get() && ok;
+    }
+    if (!ok) {
+        output.clear();
+    }
+    return ok;
+}
+
+void HuffmanCompressor::writeContainerHeader(uint64_t original_size, std::vector<uint8_t>& out) const {
+    out.insert(out.end(), kContainerMagic, kContainerMagic + sizeof(kContainerMagic));
+    out.push_back(kContainerVersion);
+    out.push_back(static_cast<uint8_t>(codec_));
+    out.push_back(0);
+    out.push_back(0);
+    putU32(out, static_cast<uint32_t>(block_size_));
+    putU64(out, original_size);
+}
+
+bool HuffmanCompressor::readContainerHeader(const uint8_t* header, size_t& block_size,
+                                            uint64_t& original_size) const {
+    if (!isContainer(header, kContainerHeaderSize) || header[4] != kContainerVersion ||
+        header[5] > static_cast<uint8_t>(CodecId::Lz77Huffman)) {
+        return false;
+    }
+    block_size = getU32(header + 8);
+    original_size = getU64(header + 12);
+    return block_size > 0 && block_size <= kMaxBlockSize;
+}
+
+void HuffmanCompressor::writeContainerTrailer(const std::vector<HuffmanBlockIndexEntry>& index,
+                                              uint64_t index_offset,
+                                              std::vector<uint8_t>& out) const {
+    // Empty frame terminates the block list for sequential readers
+    putU32(out, 0);
+    putU32(out, 0);
+    putU32(out, 0);
+    index_offset += kFrameHeaderSize;
+    
+    for (const auto& entry : index) {
+        putU64(out, entry.offset);
+        putU32(out, entry.raw_size);
+    }
+    
+    putU32(out, static_cast<uint32_t>(index.size()));
+    putU64(out, index_offset);
+    out.insert(out.end(), kIndexMagic, kIndexMagic + sizeof(kIndexMagic));
+}
+
+bool HuffmanCompressor::checkContainerTrailer(const std::vector<HuffmanBlockIndexEntry>& index,
+                                              uint64_t index_offset,
+                                              const uint8_t* trailer, size_t trailer_size) const {
+    std::vector<uint8_t> expected;
+    writeContainerTrailer(index, index_offset, expected);
+    return trailer_size == expected.size() && std::equal(expected.begin(), expected.end(), trailer);
+}
+
+bool HuffmanCompressor::compressBlock(const uint8_t* data, size_t size, std::vector<uint8_t>& frame) {
+    // Frame: [raw_size(4)][payload_size(4)][crc32(4)]
+    // Payload: an entropy-coded stream (see encodeStream), or
+    //          [kBlockLz77] then the literal, length and offset streams, each
+    //          as [raw_size(4)][payload_size(4)][stream], or
+    //          [kBlockStored][raw bytes] when coding would not shrink the block
+    size_t frame_start = frame.size();
+    putU32(frame, static_cast<uint32_t>(size));
+    putU32(frame, 0);
+    putU32(frame, blockChecksum(data, size));
+    
+    if (codec_ == CodecId::Store ||
+        (entropy_probe_ && sampledEntropy(data, size) >= kStoreEntropyBits)) {
+        writeStoredPayload(frame, frame_start, data, size);
+        return true;
+    }
+    
+    if (codec_ == CodecId::Lz77Huffman) {
+        Lz77Matcher matcher(match_chain_);
+        Lz77Streams streams;
+        matcher.parse(data, size, streams);
+        
+        frame.push_back(kBlockLz77);
+        for (const std::vector<uint8_t>* stream : {&streams.literals, &streams.lengths, &streams.offsets}) {
+            putU32(frame, static_cast<uint32_t>(stream->size()));
+            size_t size_pos = frame.size();
+            putU32(frame, 0);
+            encodeStream(stream->data(), stream->size(), frame);
+            patchU32(frame, size_pos, static_cast<uint32_t>(frame.size() - size_pos - sizeof(uint32_t)));
+        }
+    } else {
+        encodeStream(data, size, frame);
+    }
+    
+    size_t payload_size = frame.size() - frame_start - kFrameHeaderSize;
+    if (payload_size >= size + 1) {
+        writeStoredPayload(frame, frame_start, data, size);
+        return true;
+    }
+    patchU32(frame, frame_start + 4, static_cast<uint32_t>(payload_size));
+    return true;
+}
+
+void HuffmanCompressor::encodeStream(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    // [kBlockHuffman][code_lengths][data_bits(8)][encoded_data], or
+    // [kBlockStored][raw bytes] when coding would not shrink the data.
+    // Codes are derived from this stream's histogram alone.
+    size_t start = out.size();
+    if (size > 0) {
+        buildFrequencyTable(data, size);
+        buildCodeLengths();
+        limitCodeLengths(max_code_length_);
+        canonicalizeCodes(huffman_codes_);
+        
+        out.push_back(kBlockHuffman);
+        writeCodeLengths(out);
+        
+        uint64_t data_bits = encodedBits();
+        if (out.size() - start + sizeof(uint64_t) + (data_bits + 7) / 8 < size + 1) {
+            putU64(out, data_bits);
+            encodeData(data, size, out);
+            return;
+        }
+        out.resize(start);
+    }
+    
+    out.push_back(kBlockStored);
+    out.insert(out.end(), data, data + size);
+}
+
+bool HuffmanCompressor::decodeStream(const uint8_t* payload, size_t payload_size,
+                                     uint8_t* output, size_t raw_size) {
+    if (payload_size == 0) {
+        return false;
+    }
+    if (payload[0] == kBlockStored) {
+        if (payload_size - 1 != raw_size) {
+            return false;
+        }
+        if (raw_size > 0) {
+            std::memcpy(output, payload + 1, raw_size);
+        }
+        return true;
+    }
+    if (payload[0] != kBlockHuffman) {
+        return false;
+    }
+    
+    HuffmanCode codes[256];
+    size_t pos = 1;
+    if (!readCodeLengths(payload, payload_size, pos, codes) ||
+        payload_size - pos < sizeof(uint64_t)) {
+        return false;
+    }
+    canonicalizeCodes(codes);
+    
+    uint64_t data_bits = getU64(payload + pos);
+    pos += sizeof(data_bits);
+    if ((data_bits + 7) / 8 != payload_size - pos) {
+        return false;
+    }
+    
+    // Exactly raw_size symbols are decoded, so padding bits are never read
+    return decodeData(payload + pos, payload_size - pos, codes, data_bits, output, raw_size) == raw_size;
+}
+
+bool HuffmanCompressor::decompressBlock(const uint8_t* payload, size_t payload_size,
+                                        uint8_t* output, size_t raw_size, uint32_t checksum) {
+    if (payload_size == 0) {
+        return false;
+    }
+    if (payload[0] != kBlockLz77) {
+        return decodeStream(payload, payload_size, output, raw_size) &&
+               blockChecksum(output, raw_size) == checksum;
+    }
+    
+    Lz77Streams streams;
+    size_t pos = 1;
+    for (std::vector<uint8_t>* stream : {&streams.literals, &streams.lengths, &streams.offsets}) {
+        if (payload_size - pos < 2 * sizeof(uint32_t)) {
+            return false;
+        }
+        uint32_t stream_size = getU32(payload + pos);
+        uint32_t stream_payload_size = getU32(payload + pos + 4);
+        pos += 2 * sizeof(uint32_t);
+        
+        // No stream holds more than two varint bytes per block byte
+        if (stream_payload_size > payload_size - pos || stream_size > 2 * raw_size + 16) {
+            return false;
+        }
+        stream->resize(stream_size);
+        if (!decodeStream(payload + pos, stream_payload_size, stream->data(), stream_size)) {
+            return false;
+        }
+        pos += stream_payload_size;
+    }
+    
+    return pos == payload_size && Lz77Matcher::expand(streams, output, raw_size) &&
+           blockChecksum(output, raw_size) == checksum;
+}
+
+bool HuffmanCompressor::decompressLegacy(const uint8_t* input, size_t input_size,
+                                         std::vector<uint8_t>& output) {
+    if (input_size < sizeof(uint32_t) * 2) {
         return false;
     }
     
@@ -169,30 +1091,44 @@ bool HuffmanCompressor::decompressData(const std::vector<uint8_t>& input, std::v
         size_t pos = 0;
         
         // Read tree size
-        uint32_t tree_size = *reinterpret_cast<const uint32_t*>(input.data() + pos);
+        uint32_t tree_size = getU32(input + pos);
         pos += sizeof(tree_size);
         
-        if (pos + tree_size + sizeof(uint32_t) > input.size()) {
+        if (tree_size > input_size - pos || input_size - pos - tree_size < sizeof(uint32_t)) {
             return false;
         }
         
-        // Read tree data
-        std::vector<uint8_t> tree_data(input.begin() + pos, input.begin() + pos + tree_size);
+        // Recover each leaf's code from the serialized tree
+        HuffmanCode codes[256];
+        if (!deserializeTree(input + pos, tree_size, codes)) {
+            return false;
+        }
         pos += tree_size;
         
-        // Read encoded data size (in bits)
-        uint32_t data_bits = *reinterpret_cast<const uint32_t*>(input.data() + pos);
+        // Read encoded data size (in bits). Old files rounded this up to whole
+        // bytes and did not record the symbol count.
+        uint32_t data_bits = getU32(input + pos);
         pos += sizeof(data_bits);
         
-        // Read encoded data
-        std::vector<uint8_t> encoded_data(input.begin() + pos, input.end());
-        
-        // Rebuild Huffman tree
-        size_t tree_pos = 0;
-        root_ = deserializeTree(tree_data, tree_pos);
+        int min_length = HuffmanDecodeTable::kMaxCodeLength + 1;
+        int max_length = 0;
+        for (const auto& code : codes) {
+            if (code.length > 0) {
+                min_length = std::min<int>(min_length, code.length);
+                max_length = std::max<int>(max_length, code.length);
+            }
+        }
         
         // Decode data
-        output = decodeData(encoded_data, root_, data_bits);
+        if (max_length > HuffmanDecodeTable::kMaxCodeLength) {
+            output = decodeDataTreeWalk(input + pos, input_size - pos, codes, data_bits);
+        } else {
+            // No symbol is shorter than the shortest code, which bounds the output
+            uint64_t bits = std::min<uint64_t>(data_bits, uint64_t(input_size - pos) * 8);
+            output.resize(bits / min_length);
+            output.resize(decodeData(input + pos, input_size - pos, codes, bits,
+                                     output.data(), output.size()));
+        }
         
         return !output.empty();
         
@@ -202,146 +1138,483 @@ bool HuffmanCompressor::decompressData(const std::vector<uint8_t>& input, std::v
     }
 }
 
-void HuffmanCompressor::buildFrequencyTable(const std::vector<uint8_t>& data) {
-    frequency_table_.clear();
-    for (uint8_t byte : data) {
-        frequency_table_[byte]++;
+void HuffmanCompressor::buildFrequencyTable(const uint8_t* data, size_t size) {
+    countBytes(data, size, frequency_table_);
+}
+
+void HuffmanCompressor::buildCodeLengths() {
+    // Two-queue Huffman construction over a fixed node array: leaves sorted
+    // by frequency form one queue, merged nodes (created in non-decreasing
+    // weight order) form the other. Only parent links are kept.
+    struct Node {
+        uint64_t weight;
+        int parent;
+    };
+    Node nodes[511];
+    int leaf_symbol[256];
+    int leaf_count = 0;
+    
+    for (int symbol = 0; symbol < 256; symbol++) {
+        if (frequency_table_[symbol] > 0) {
+            leaf_symbol[leaf_count++] = symbol;
+        }
+    }
+    std::sort(leaf_symbol, leaf_symbol + leaf_count, [this](int a, int b) {
+        uint32_t fa = frequency_table_[a];
+        uint32_t fb = frequency_table_[b];
+        return fa != fb ? fa < fb : a < b;
+    });
+    for (int i = 0; i < leaf_count; i++) {
+        nodes[i].weight = frequency_table_[leaf_symbol[i]];
+        nodes[i].parent = -1;
+    }
+    
+    for (auto& code : huffman_codes_) {
+        code = HuffmanCode();
+    }
+    if (leaf_count == 0) {
+        return;
+    }
+    if (leaf_count == 1) {
+        // A lone symbol still needs a one-bit code
+        huffman_codes_[leaf_symbol[0]].length = 1;
+        return;
+    }
+    
+    int next_leaf = 0;
+    int next_merged = leaf_count;
+    int node_count = leaf_count;
+    auto takeSmallest = [&]() {
+        if (next_leaf < leaf_count &&
+            (next_merged == node_count || nodes[next_leaf].weight <= nodes[next_merged].weight)) {
+            return next_leaf++;
+        }
+        return next_merged++;
+    };
+    
+    while (node_count < 2 * leaf_count - 1) {
+        int left = takeSmallest();
+        int right = takeSmallest();
+        nodes[node_count].weight = nodes[left].weight + nodes[right].weight;
+        nodes[node_count].parent = -1;
+        nodes[left].parent = node_count;
+        nodes[right].parent = node_count;
+        node_count++;
+    }
+    
+    // Parents always have higher indices, so one downward pass gives depths
+    int depth[511];
+    depth[node_count - 1] = 0;
+    for (int i = node_count - 2; i >= 0; i--) {
+        depth[i] = depth[nodes[i].parent] + 1;
+    }
+    for (int i = 0; i < leaf_count; i++) {
+        huffman_codes_[leaf_symbol[i]].length = static_cast<uint8_t>(depth[i]);
     }
 }
 
-void HuffmanCompressor::buildHuffmanTree() {
-    std::priority_queue<std::shared_ptr<HuffmanNode>, 
-                       std::vector<std::shared_ptr<HuffmanNode>>, 
-                       CompareNodes> pq;
+void HuffmanCompressor::limitCodeLengths(int max_length) {
+    // Order symbols from least to most frequent; Huffman lengths are
+    // non-increasing along this order
+    int symbols[256];
+    int count = 0;
+    int longest = 0;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        if (frequency_table_[symbol] > 0) {
+            symbols[count++] = symbol;
+            longest = std::max<int>(longest, huffman_codes_[symbol].length);
+        }
+    }
+    if (longest <= max_length) {
+        return;
+    }
+    std::sort(symbols, symbols + count, [this](int a, int b) {
+        uint32_t fa = frequency_table_[a];
+        uint32_t fb = frequency_table_[b];
+        return fa != fb ? fa < fb : a > b;
+    });
     
-    // Create leaf nodes for each byte
-    for (const auto& pair : frequency_table_) {
-        pq.push(std::make_shared<HuffmanNode>(pair.first, pair.second));
+    // Clamp, then restore the Kraft inequality (sum of 2^(max - length)
+    // must not exceed 2^max) by lengthening the rarest codes below the limit
+    const uint32_t full = 1u << max_length;
+    uint32_t kraft = 0;
+    for (int i = 0; i < count; i++) {
+        uint8_t& length = huffman_codes_[symbols[i]].length;
+        length = static_cast<uint8_t>(std::min<int>(length, max_length));
+        kraft += 1u << (max_length - length);
     }
     
-    // Build tree by combining nodes
-    while (pq.size() > 1) {
-        auto left = pq.top(); pq.pop();
-        auto right = pq.top(); pq.pop();
-        
-        auto parent = std::make_shared<HuffmanNode>(0, left->frequency + right->frequency);
-        parent->left = left;
-        parent->right = right;
-        
-        pq.push(parent);
+    while (kraft > full) {
+        for (int i = 0; i < count; i++) {
+            uint8_t& length = huffman_codes_[symbols[i]].length;
+            if (length < max_length) {
+                length++;
+                kraft -= 1u << (max_length - length);
+                break;
+            }
+        }
     }
     
-    root_ = pq.top();
+    // Spend any leftover code space shortening the most frequent codes
+    for (int i = count - 1; i >= 0; i--) {
+        uint8_t& length = huffman_codes_[symbols[i]].length;
+        while (length > 1 && kraft + (1u << (max_length - length)) <= full) {
+            kraft += 1u << (max_length - length);
+            length--;
+        }
+    }
 }
 
-void HuffmanCompressor::generateCodes(const std::shared_ptr<HuffmanNode>& node, const std::string& code) {
-    if (!node) return;
+uint64_t HuffmanCompressor::encodedBits() const {
+    uint64_t total_bits = 0;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        total_bits += static_cast<uint64_t>(frequency_table_[symbol]) * huffman_codes_[symbol].length;
+    }
+    return total_bits;
+}
+
+void HuffmanCompressor::canonicalizeCodes(HuffmanCode codes[256]) {
+    // Assign codes from the lengths alone: shorter codes first, then by byte
+    // value. Counting sort by length keeps this O(256).
+    int length_count[kMaxSupportedCodeLength + 1] = {0};
+    for (int symbol = 0; symbol < 256; symbol++) {
+        length_count[codes[symbol].length]++;
+    }
+    length_count[0] = 0;
     
-    if (node->isLeaf()) {
-        huffman_codes_[node->byte] = code;
-    } else {
-        generateCodes(node->left, code + "0");
-        generateCodes(node->right, code + "1");
+    uint64_t next_code[kMaxSupportedCodeLength + 1] = {0};
+    uint64_t code = 0;
+    for (int length = 1; length <= kMaxSupportedCodeLength; length++) {
+        code = (code + length_count[length - 1]) << 1;
+        next_code[length] = code;
+    }
+    
+    for (int symbol = 0; symbol < 256; symbol++) {
+        int length = codes[symbol].length;
+        if (length > 0) {
+            codes[symbol].code = next_code[length]++;
+        }
+    }
+}
+
+void HuffmanCompressor::writeCodeLengths(std::vector<uint8_t>& out) const {
+    // One byte per symbol; a zero is followed by (run length - 1) so unused
+    // byte ranges cost two bytes
+    int symbol = 0;
+    while (symbol < 256) {
+        uint8_t length = huffman_codes_[symbol].length;
+        out.push_back(length);
+        if (length != 0) {
+            symbol++;
+            continue;
+        }
+        int run = 1;
+        while (symbol + run < 256 && huffman_codes_[symbol + run].length == 0) {
+            run++;
+        }
+        out.push_back(static_cast<uint8_t>(run - 1));
+        symbol += run;
     }
 }
 
-std::vector<uint8_t> HuffmanCompressor::serializeTree() {
-    std::vector<uint8_t> result;
+bool HuffmanCompressor::readCodeLengths(const uint8_t* data, size_t size, size_t& pos,
+                                        HuffmanCode codes[256]) {
+    // Lengths must describe a prefix code no longer than the table decoder
+    // supports
+    const int max_length = HuffmanDecodeTable::kMaxCodeLength;
+    uint64_t kraft = 0;  // sum of 2^(max_length - length)
+    int used = 0;
+    int symbol = 0;
     
-    // Simple serialization: pre-order traversal
-    // For leaf: '1' + byte, for internal node: '0'
-    std::function<void(const std::shared_ptr<HuffmanNode>&)> serialize;
-    serialize = [&](const std::shared_ptr<HuffmanNode>& node) {
-        if (node->isLeaf()) {
-            result.push_back(1); // Leaf marker
-            result.push_back(node->byte);
-        } else {
-            result.push_back(0); // Internal node marker
-            serialize(node->left);
-            serialize(node->right);
+    while (symbol < 256) {
+        if (pos >= size) {
+            return false;
         }
-    };
+        uint8_t length = data[pos++];
+        if (length == 0) {
+            if (pos >= size) {
+                return false;
+            }
+            int run = data[pos++] + 1;
+            if (symbol + run > 256) {
+                return false;
+            }
+            for (int i = 0; i < run; i++) {
+                codes[symbol++] = HuffmanCode();
+            }
+            continue;
+        }
+        if (length > max_length) {
+            return false;
+        }
+        codes[symbol].code = 0;
+        codes[symbol].length = length;
+        kraft += uint64_t(1) << (max_length - length);
+        used++;
+        symbol++;
+    }
     
-    serialize(root_);
-    return result;
+    return used > 0 && kraft <= (uint64_t(1) << max_length);
 }
 
-std::shared_ptr<HuffmanNode> HuffmanCompressor::deserializeTree(const std::vector<uint8_t>& tree_data, size_t& pos) {
-    if (pos >= tree_data.size()) {
-        return nullptr;
+bool HuffmanCompressor::deserializeTree(const uint8_t* tree_data, size_t tree_size,
+                                        HuffmanCode codes[256]) {
+    // Pre-order walk with an explicit stack of pending right-child codes;
+    // a full binary tree over 256 leaves has at most 511 nodes
+    for (int symbol = 0; symbol < 256; symbol++) {
+        codes[symbol] = HuffmanCode();
     }
     
-    uint8_t marker = tree_data[pos++];
+    HuffmanCode pending[256];
+    int pending_count = 0;
+    HuffmanCode current;
+    size_t pos = 0;
+    int leaves = 0;
     
-    if (marker == 1) { // Leaf node
-        if (pos >= tree_data.size()) {
-            return nullptr;
+    while (true) {
+        if (pos >= tree_size) {
+            return false;
+        }
+        uint8_t marker = tree_data[pos++];
+        
+        if (marker == 0) { // Internal node: visit left now, right later
+            if (current.length >= kMaxSupportedCodeLength || pending_count == 256) {
+                return false;
+            }
+            current.code <<= 1;
+            current.length++;
+            HuffmanCode right = current;
+            right.code |= 1;
+            pending[pending_count++] = right;
+            continue;
+        }
+        
+        if (marker != 1 || pos >= tree_size || current.length == 0) {
+            return false; // Bad marker, truncated leaf or bare leaf root
         }
         uint8_t byte = tree_data[pos++];
-        return std::make_shared<HuffmanNode>(byte, 0);
-    } else if (marker == 0) { // Internal node
-        auto node = std::make_shared<HuffmanNode>(0, 0);
-        node->left = deserializeTree(tree_data, pos);
-        node->right = deserializeTree(tree_data, pos);
-        return node;
+        if (codes[byte].length != 0 || ++leaves > 256) {
+            return false;
+        }
+        codes[byte] = current;
+        
+        if (pending_count == 0) {
+            return true;
+        }
+        current = pending[--pending_count];
+    }
+}
+
+void HuffmanCompressor::encodeData(const uint8_t* data, size_t size, std::vector<uint8_t>& encoded) {
+    // The histogram gives the exact encoded size, so write through a raw
+    // pointer into storage sized once up front
+    uint64_t total_bits = encodedBits();
+    
+    size_t start = encoded.size();
+    encoded.resize(start + (total_bits + 7) / 8 + sizeof(uint32_t));
+    uint8_t* out = encoded.data() + start;
+    
+    // Codewords (at most 20 bits) are appended MSB-first to a 64-bit
+    // accumulator; whole 32-bit words are flushed as soon as they complete.
+    uint64_t accumulator = 0;
+    int pending_bits = 0;
+    
+    auto flushWord = [&]() {
+        uint32_t word = static_cast<uint32_t>(accumulator >> (pending_bits - 32));
+        out[0] = static_cast<uint8_t>(word >> 24);
+        out[1] = static_cast<uint8_t>(word >> 16);
+        out[2] = static_cast<uint8_t>(word >> 8);
+        out[3] = static_cast<uint8_t>(word);
+        out += 4;
+        pending_bits -= 32;
+    };
+    
+    for (size_t i = 0; i < size; i++) {
+        const HuffmanCode& code = huffman_codes_[data[i]];
+        accumulator = (accumulator << code.length) | code.code;
+        pending_bits += code.length;
+        if (pending_bits >= 32) {
+            flushWord();
+        }
     }
     
-    return nullptr;
+    // Remaining bits, zero-padded to a whole byte
+    while (pending_bits > 0) {
+        int shift = pending_bits - 8;
+        *out++ = static_cast<uint8_t>(shift >= 0 ? accumulator >> shift : accumulator << -shift);
+        pending_bits -= 8;
+    }
+    
+    encoded.resize(out - encoded.data());
 }
 
-std::vector<uint8_t> HuffmanCompressor::encodeData(const std::vector<uint8_t>& data) {
-    std::vector<uint8_t> encoded;
-    size_t bit_pos = 0;
-    uint8_t current_byte = 0;
+bool HuffmanCompressor::buildDecodeTable(const HuffmanCode codes[256], HuffmanDecodeTable& table) {
+    table.max_length = 0;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        table.max_length = std::max<int>(table.max_length, codes[symbol].length);
+    }
+    if (table.max_length == 0 || table.max_length > HuffmanDecodeTable::kMaxCodeLength) {
+        return false;
+    }
     
-    for (uint8_t byte : data) {
-        const std::string& code = huffman_codes_[byte];
-        for (char bit : code) {
-            if (bit == '1') {
-                current_byte |= (1 << (7 - bit_pos));
-            }
-            bit_pos++;
-            
-            if (bit_pos == 8) {
-                encoded.push_back(current_byte);
-                current_byte = 0;
-                bit_pos = 0;
-            }
+    const int primary_bits = std::min(table.max_length, HuffmanDecodeTable::kPrimaryBits);
+    table.primary_bits = primary_bits;
+    table.entries.assign(size_t(1) << primary_bits, 0);
+    
+    // Size the secondary table behind each long-code prefix
+    int sub_bits[1 << HuffmanDecodeTable::kPrimaryBits] = {0};
+    for (int symbol = 0; symbol < 256; symbol++) {
+        int length = codes[symbol].length;
+        if (length > primary_bits) {
+            uint64_t prefix = codes[symbol].code >> (length - primary_bits);
+            sub_bits[prefix] = std::max(sub_bits[prefix], length - primary_bits);
+        }
+    }
+    const size_t primary_size = table.entries.size();
+    for (size_t prefix = 0; prefix < primary_size; prefix++) {
+        if (sub_bits[prefix] > 0) {
+            uint32_t offset = static_cast<uint32_t>(table.entries.size());
+            table.entries[prefix] = HuffmanDecodeTable::kLinkFlag |
+                                    (static_cast<uint32_t>(sub_bits[prefix]) << 24) | offset;
+            table.entries.resize(table.entries.size() + (size_t(1) << sub_bits[prefix]), 0);
         }
     }
     
-    // Add remaining bits
-    if (bit_pos > 0) {
-        encoded.push_back(current_byte);
+    // Fill every slot whose leading bits match each code
+    for (int symbol = 0; symbol < 256; symbol++) {
+        int length = codes[symbol].length;
+        if (length == 0) {
+            continue;
+        }
+        uint64_t code = codes[symbol].code;
+        uint32_t entry = (static_cast<uint32_t>(length) << 16) | static_cast<uint32_t>(symbol);
+        size_t first, count;
+        if (length <= primary_bits) {
+            first = size_t(code) << (primary_bits - length);
+            count = size_t(1) << (primary_bits - length);
+        } else {
+            uint32_t link = table.entries[code >> (length - primary_bits)];
+            int bits = static_cast<int>((link >> 24) & 0x7F);
+            int extra = length - primary_bits;
+            uint64_t suffix = code & ((uint64_t(1) << extra) - 1);
+            first = (link & 0xFFFFFF) + (size_t(suffix) << (bits - extra));
+            count = size_t(1) << (bits - extra);
+        }
+        std::fill(table.entries.begin() + first, table.entries.begin() + first + count, entry);
     }
     
-    return encoded;
+    return true;
 }
 
-std::vector<uint8_t> HuffmanCompressor::decodeData(const std::vector<uint8_t>& encoded_data, 
-                                                  const std::shared_ptr<HuffmanNode>& root,
-                                                  size_t data_bits) {
+size_t HuffmanCompressor::decodeData(const uint8_t* encoded_data, size_t encoded_size,
+                                     const HuffmanCode codes[256], uint64_t data_bits,
+                                     uint8_t* output, size_t output_size) {
+    HuffmanDecodeTable& table = decode_table_;
+    if (!buildDecodeTable(codes, table)) {
+        return 0;
+    }
+    
+    const uint8_t* in = encoded_data;
+    const uint8_t* in_end = in + encoded_size;
+    const uint64_t total_bits = std::min<uint64_t>(data_bits, uint64_t(encoded_size) * 8);
+    const int primary_bits = table.primary_bits;
+    const uint32_t* entries = table.entries.data();
+    uint8_t* out = output;
+    uint8_t* const out_end = output + output_size;
+    
+    // Bits are consumed MSB-first from a left-aligned 64-bit buffer
+    uint64_t bit_buffer = 0;
+    int bit_count = 0;
+    uint64_t bits_consumed = 0;
+    
+    while (out < out_end) {
+        if (bit_count < 32) {
+            if (in_end - in >= 8) {
+                uint64_t word = 0;
+                for (int i = 0; i < 8; i++) {
+                    word = (word << 8) | in[i];
+                }
+                bit_buffer |= word >> bit_count;
+                int bytes = (63 - bit_count) >> 3;
+                in += bytes;
+                bit_count += bytes * 8;
+            } else {
+                while (bit_count <= 56 && in < in_end) {
+                    bit_buffer |= static_cast<uint64_t>(*in++) << (56 - bit_count);
+                    bit_count += 8;
+                }
+            }
+        }
+        
+        uint32_t entry = entries[bit_buffer >> (64 - primary_bits)];
+        if (entry & HuffmanDecodeTable::kLinkFlag) {
+            int sub_bits = static_cast<int>((entry >> 24) & 0x7F);
+            uint64_t index = (bit_buffer << primary_bits) >> (64 - sub_bits);
+            entry = entries[(entry & 0xFFFFFF) + index];
+        }
+        
+        int length = static_cast<int>(entry >> 16);
+        if (length == 0 || bits_consumed + length > total_bits) {
+            break; // Unused code or trailing partial code
+        }
+        
+        *out++ = static_cast<uint8_t>(entry);
+        bit_buffer <<= length;
+        bit_count -= length;
+        bits_consumed += length;
+    }
+    
+    return static_cast<size_t>(out - output);
+}
+
+std::vector<uint8_t> HuffmanCompressor::decodeDataTreeWalk(const uint8_t* encoded_data,
+                                                          size_t encoded_size,
+                                                          const HuffmanCode codes[256],
+                                                          size_t data_bits) {
+    // Rebuild the code tree in a fixed node array for codes too long for
+    // the lookup table. child[n][bit] > 0 is a node index, < 0 is ~symbol.
+    int child[511][2] = {{0}};
+    int node_count = 1;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        int length = codes[symbol].length;
+        int node = 0;
+        for (int bit = length - 1; bit >= 0; bit--) {
+            int branch = static_cast<int>((codes[symbol].code >> bit) & 1);
+            if (bit == 0) {
+                child[node][branch] = ~symbol;
+            } else {
+                if (child[node][branch] <= 0) {
+                    if (node_count == 511) {
+                        return {};
+                    }
+                    child[node][branch] = node_count++;
+                }
+                node = child[node][branch];
+            }
+        }
+    }
+    
     std::vector<uint8_t> decoded;
-    auto current_node = root;
+    int current_node = 0;
     size_t bits_processed = 0;
     
-    for (uint8_t byte : encoded_data) {
+    for (size_t pos = 0; pos < encoded_size; pos++) {
+        uint8_t byte = encoded_data[pos];
         for (int i = 7; i >= 0; i--) {
             if (bits_processed >= data_bits) {
                 break;
             }
             
-            uint8_t bit = (byte >> i) & 1;
-            
-            if (bit == 0) {
-                current_node = current_node->left;
-            } else {
-                current_node = current_node->right;
+            int next = child[current_node][(byte >> i) & 1];
+            if (next == 0) {
+                return decoded; // No code continues with this bit
             }
             
-            if (current_node->isLeaf()) {
-                decoded.push_back(current_node->byte);
-                current_node = root;
+            if (next < 0) {
+                decoded.push_back(static_cast<uint8_t>(~next));
+                current_node = 0;
+            } else {
+                current_node = next;
             }
             
             bits_processed++;
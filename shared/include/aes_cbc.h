@@ -3,29 +3,128 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+
+class ThreadPool;
+
+// Encrypts a plaintext that arrives in pieces. The concatenated output is
+// exactly what encryptFile ("cbc") or encryptFileGCM ("gcm") writes for the
+// whole plaintext, so a producer can stream into the cipher without an
+// intermediate file. Each call appends the ciphertext that became ready.
+class CapsuleEncryptor {
+public:
+    virtual ~CapsuleEncryptor() = default;
+    
+    virtual bool update(const uint8_t* data, size_t size, std::vector<uint8_t>& output) = 0;
+    virtual bool finish(std::vector<uint8_t>& output) = 0;
+};
+
+// Inverse of CapsuleEncryptor: decrypts a capsule that arrives in pieces
+// and appends the plaintext that became ready. GCM chunks are verified as
+// they complete; the CBC padding and the final GCM chunk are checked by
+// finish(), so nothing is known to be the whole plaintext before then.
+class CapsuleDecryptor {
+public:
+    virtual ~CapsuleDecryptor() = default;
+    
+    virtual bool update(const uint8_t* data, size_t size, std::vector<uint8_t>& output) = 0;
+    virtual bool finish(std::vector<uint8_t>& output) = 0;
+};
 
 class AESCrypto {
 public:
     AESCrypto();
     ~AESCrypto();
     
-    // File-based operations
+    // File-based operations. Files are processed in fixed-size chunks, so
+    // memory use does not grow with file size. CBC decryption of each chunk
+    // is split into ranges run on `threads` workers (0 = all cores) while
+    // the next chunk is read; the output matches single-threaded decryption.
     bool encryptFile(const std::string& input_file, const std::string& output_file,
                     const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv);
     bool decryptFile(const std::string& input_file, const std::string& output_file,
-                    const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv);
+                    const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv,
+                    size_t threads = 0);
+    
+    // Authenticated, chunked AES-GCM capsules (see aes_gcm.cpp). Chunks are
+    // sealed and verified independently on `threads` workers (0 = all
+    // cores); decryption stops at the first chunk that fails verification
+    // and removes the partial output. The first 8 IV bytes form the nonce
+    // prefix, which is stored in the capsule header.
+    bool encryptFileGCM(const std::string& input_file, const std::string& output_file,
+                       const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv,
+                       size_t threads = 0);
+    bool decryptFileGCM(const std::string& input_file, const std::string& output_file,
+                       const std::vector<uint8_t>& key, size_t threads = 0);
+    static bool isGCMFile(const std::string& file_path);
+    // The check isGCMFile makes on a capsule's first kGCMPrefixSize bytes
+    static constexpr size_t kGCMPrefixSize = 8;
+    static bool isGCMPrefix(const uint8_t* prefix);
+    
+    // Streaming encryption for `mode` "cbc" or "gcm"; null for an unknown
+    // mode or a bad key or IV. GCM chunks are sealed on `threads` workers
+    // (0 = all cores) and emitted in order; CBC encryption is inherently
+    // sequential and runs on the calling thread.
+    static std::unique_ptr<CapsuleEncryptor> createEncryptor(const std::string& mode,
+                                                             const std::vector<uint8_t>& key,
+                                                             const std::vector<uint8_t>& iv,
+                                                             size_t threads = 0);
+    // Streaming decryption. GCM capsules are recognized by their header,
+    // as in isGCMFile; anything else is CBC under `iv`. GCM chunks are
+    // opened, and large CBC pieces decrypted in ranges, on `threads`
+    // workers (0 = all cores).
+    static std::unique_ptr<CapsuleDecryptor> createDecryptor(const std::vector<uint8_t>& key,
+                                                             const std::vector<uint8_t>& iv,
+                                                             size_t threads = 0);
     
-    // Memory-based operations
+    // Memory-based operations. The CBC key schedule is kept between calls
+    // and only rebuilt when the key changes; a new IV just resynchronizes
+    // the cached cipher. Large decryptions run on a worker pool that is
+    // likewise kept, so repeated calls do not start threads each time.
     bool encryptData(const std::vector<uint8_t>& input, std::vector<uint8_t>& output,
                     const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv);
     bool decryptData(const std::vector<uint8_t>& input, std::vector<uint8_t>& output,
+                    const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv,
+                    size_t threads = 0);
+    
+    // Caller-buffer variants for mapped or pooled memory; they do not
+    // allocate once the key is cached. `output` may be `input` itself (in
+    // place) but must not otherwise overlap it. Encryption needs
+    // paddedSize(input_size) bytes of output and pads only the final block;
+    // decryption needs input_size bytes. output_size receives the bytes
+    // written.
+    bool encryptData(const uint8_t* input, size_t input_size,
+                    uint8_t* output, size_t output_capacity, size_t& output_size,
+                    const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv);
+    bool decryptData(const uint8_t* input, size_t input_size,
+                    uint8_t* output, size_t output_capacity, size_t& output_size,
                     const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv);
+    static size_t paddedSize(size_t plain_size);
     
-    // Key derivation
+    // Key derivation. With a key cache enabled, results are kept for the
+    // most recent `capacity` (password, salt, iterations, size) inputs,
+    // identified by a SHA-256 of the password rather than the password
+    // itself; evicted and cleared keys are zeroized. Disabled by default.
     static std::vector<uint8_t> deriveKeyPBKDF2(const std::string& password,
                                                const std::vector<uint8_t>& salt,
                                                size_t key_size = 32,
                                                int iterations = 100000);
+    static void setKeyCacheCapacity(size_t capacity);
+    static void clearKeyCache();
+    
+    // Enables the key cache with at least `capacity` entries for as long as
+    // any scope is alive, so owners with overlapping lifetimes can share it;
+    // the last scope to end clears and disables it
+    class KeyCacheScope {
+    public:
+        explicit KeyCacheScope(size_t capacity);
+        KeyCacheScope(const KeyCacheScope& other);
+        KeyCacheScope& operator=(const KeyCacheScope& other) = default;
+        ~KeyCacheScope();
+        
+    private:
+        size_t capacity_;
+    };
     
     // Utility functions
     static std::vector<uint8_t> generateRandomIV();
@@ -33,10 +132,28 @@ public:
     bool validateKey(const std::vector<uint8_t>& key);
     
 private:
-    void addPadding(std::vector<uint8_t>& data);
-    void removePadding(std::vector<uint8_t>& data);
+    struct CipherContext;
+    class CBCStreamEncryptor;
+    class CBCStreamDecryptor;
+    class DetectingDecryptor;
+    
+    static std::unique_ptr<CapsuleEncryptor> createGCMEncryptor(const std::vector<uint8_t>& key,
+                                                                const std::vector<uint8_t>& iv,
+                                                                size_t threads);
+    static std::unique_ptr<CapsuleDecryptor> createGCMDecryptor(const std::vector<uint8_t>& key,
+                                                                size_t threads);
+    
+    // Pool of up to `threads` workers (0 = all cores) for `work_items`
+    // independent tasks; null when one thread would do
+    static std::unique_ptr<ThreadPool> createPool(size_t threads, size_t work_items);
+    bool checkKeyAndIV(const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv);
+    static size_t addPadding(uint8_t* data, size_t size);
+    static bool paddingLength(const uint8_t* data, size_t size, size_t& padding);
+    bool removePadding(std::vector<uint8_t>& data);
     std::vector<uint8_t> xorWithIV(const std::vector<uint8_t>& data, 
                                   const std::vector<uint8_t>& iv);
+    
+    std::unique_ptr<CipherContext> context_;
 };
 
 #endif // AES_CBC_H
\ No newline at end of file
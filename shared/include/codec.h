@@ -0,0 +1,75 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+// Identifies how a capsule's blocks were transformed before entropy coding.
+// Stored in the compressed file header, so receivers pick the decoder from
+// the file itself.
+enum class CodecId : uint8_t {
+    Store = 0,         // blocks kept as-is
+    Huffman = 1,       // order-0 canonical Huffman per block
+    Lz77Huffman = 2    // LZ77 sequences, each stream Huffman coded
+};
+
+// Receives a compressed stream in order, one piece at a time, and may keep
+// the piece's buffer. Returning false stops compression.
+typedef std::function<bool(std::vector<uint8_t>&& piece)> ByteSink;
+
+// Decodes a compressed container that arrives in pieces, handing the
+// original bytes to the sink in order as blocks complete. Blocks record
+// their own transform, so one decoder reads every codec's containers.
+// finish() checks that the stream ended with a complete container.
+class StreamDecompressor {
+public:
+    virtual ~StreamDecompressor() = default;
+    
+    virtual bool update(const uint8_t* data, size_t size) = 0;
+    virtual bool finish() = 0;
+};
+
+class CompressionCodec {
+public:
+    virtual ~CompressionCodec() = default;
+    
+    virtual CodecId id() const = 0;
+    
+    virtual bool compressFile(const std::string& input_file, const std::string& output_file) = 0;
+    virtual bool compressFile(const std::string& input_file, const ByteSink& sink) = 0;
+    virtual bool decompressFile(const std::string& input_file, const std::string& output_file) = 0;
+    virtual bool compressData(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) = 0;
+    virtual bool decompressData(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) = 0;
+    
+    // Worker threads for block compression/decompression (0 = all cores)
+    virtual void setThreadCount(size_t thread_count) = 0;
+};
+
+// Compression levels (--level): 0 stores, 1-3 Huffman only, 4-9 LZ77 +
+// Huffman searching longer match chains at higher levels
+constexpr int kMinCompressionLevel = 0;
+constexpr int kMaxCompressionLevel = 9;
+constexpr int kDefaultCompressionLevel = 6;
+
+const char* codecName(CodecId id);
+
+std::unique_ptr<CompressionCodec> createCodec(CodecId id);
+std::unique_ptr<CompressionCodec> createCodecForLevel(int level);
+
+// Largest container compressData can produce for `input_size` bytes with
+// any codec; incompressible blocks are stored, so this is the input plus
+// framing
+uint64_t maxCompressedSize(uint64_t input_size);
+
+// Streaming decoder for containers of any codec, decoding blocks on
+// `threads` workers (0 = all cores)
+std::unique_ptr<StreamDecompressor> createStreamDecompressor(const ByteSink& sink, size_t threads = 0);
+
+// Codec recorded in a compressed file's header; files from before codec
+// IDs are Huffman
+bool readCodecId(const std::string& compressed_file, CodecId& id);
+
+#endif // CODEC_H
@@ -0,0 +1,44 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Hex and base64 (RFC 4648, padded) codecs for digests, fingerprints and
+// key material. Nothing is looked up in a memory table indexed by the
+// data, so running time depends only on the input length (and, when
+// decoding, on whether the input is valid), never on the bytes themselves.
+// SSSE3 handles 16 bytes at a time where the CPU has it (checked at run
+// time). The pointer forms write into caller-owned buffers and never
+// allocate.
+namespace Encoding {
+    
+    // Writes 2 * size lowercase hex digits to out
+    void hexEncode(const uint8_t* data, size_t size, char* out);
+    // Decodes `length` hex digits of either case into length / 2 bytes;
+    // false when length is odd or any character is not a hex digit
+    bool hexDecode(const char* hex, size_t length, uint8_t* out);
+    
+    inline size_t base64EncodedSize(size_t size) { return (size + 2) / 3 * 4; }
+    // Upper bound on the bytes base64Decode writes for `length` characters
+    inline size_t base64DecodedMaxSize(size_t length) { return (length + 3) / 4 * 3; }
+    // Writes base64EncodedSize(size) characters, '=' padded, to out
+    void base64Encode(const uint8_t* data, size_t size, char* out);
+    // Accepts padded input or the same input with its padding left off;
+    // false on any other character, misplaced padding or a length that
+    // cannot be base64
+    bool base64Decode(const char* text, size_t length, uint8_t* out, size_t& out_size);
+    
+    // Allocating conveniences; the decoders return an empty vector on
+    // invalid input
+    std::string toHex(const uint8_t* data, size_t size);
+    std::string toHex(const std::vector<uint8_t>& data);
+    std::vector<uint8_t> fromHex(const std::string& hex);
+    std::string toBase64(const std::vector<uint8_t>& data);
+    std::vector<uint8_t> fromBase64(const std::string& text);
+
+} // namespace Encoding
+
+#endif // ENCODING_H
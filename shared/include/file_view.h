@@ -0,0 +1,40 @@
+#ifndef FILE_VIEW_H
+#define FILE_VIEW_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Read-only view of a whole input file. Regular files are memory-mapped
+// with a sequential access hint, so pages are read in lazily as the view is
+// walked and never copied to the heap. Pipes, devices and anything else
+// that cannot be mapped are read into an internal buffer instead.
+class FileView {
+public:
+    FileView();
+    ~FileView();
+    
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+    
+    // Replaces any previous view; prints the reason and returns false when
+    // the file cannot be opened or read
+    bool open(const std::string& path);
+    void close();
+    
+    // Valid until the view is closed or reopened; null for an empty file
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool isMapped() const { return mapping_ != nullptr; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    void* mapping_;
+    size_t mapping_size_;
+    std::vector<uint8_t> buffer_;
+};
+
+#endif // FILE_VIEW_H
@@ -4,17 +4,90 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <memory>
 
+// SHA-256 (plus SHA-1, MD5 and HMAC for interop) over Crypto++, whose
+// SHA-256 runs on SHA-NI or ARMv8 crypto extensions when the CPU has them.
+// Files are read through a fixed-size buffer, so hashing never holds more
+// than one buffer of the file in memory.
 class HashUtils {
 public:
     HashUtils();
     ~HashUtils();
     
-    // File-based hashing
+    HashUtils(const HashUtils&) = delete;
+    HashUtils& operator=(const HashUtils&) = delete;
+    
+    // Incremental SHA-256: update() with each piece of the message, then
+    // finalize() returns its hex digest and starts a new message
+    void update(const uint8_t* data, size_t size);
+    void update(const std::vector<uint8_t>& data);
+    std::string finalize();
+    void reset();
+    
+    // Tree hash: the file is split into chunk_size chunks whose SHA-256
+    // leaves (0x00 || chunk) are computed in parallel and paired up into a
+    // root (0x01 || left || right; an odd node moves up unpaired). Leaves
+    // and root are hex. A capsule carries the whole tree, so a receiver can
+    // check it across all cores and name the chunks that are corrupt.
+    static constexpr size_t kTreeChunkSize = 1 << 20;
+    struct TreeHash {
+        size_t chunk_size = kTreeChunkSize;
+        std::string root;
+        std::vector<std::string> leaves;
+    };
+    bool computeFileTreeHash(const std::string& file_path, TreeHash& tree,
+                             size_t threads = 0, size_t chunk_size = kTreeChunkSize);
+    // False when the leaves do not add up to the root or any chunk differs;
+    // corrupt_chunks lists the chunks that differ, missing or extra ones
+    // included
+    bool verifyFileTreeHash(const std::string& file_path, const TreeHash& tree,
+                            std::vector<size_t>& corrupt_chunks, size_t threads = 0);
+    static std::string computeTreeRoot(const std::vector<std::string>& leaves);
+    
+    // Tree hash of a message that arrives in pieces: each leaf is hashed as
+    // its chunk fills, so a stream gets its tree without a second pass.
+    // finish() hashes the partial last chunk and computes the root; the
+    // result matches computeFileTreeHash over the same bytes.
+    class TreeHasher {
+    public:
+        explicit TreeHasher(size_t chunk_size = kTreeChunkSize);
+        ~TreeHasher();
+        
+        TreeHasher(const TreeHasher&) = delete;
+        TreeHasher& operator=(const TreeHasher&) = delete;
+        
+        void update(const uint8_t* data, size_t size);
+        void update(const std::vector<uint8_t>& data);
+        // Leaves of the chunks completed so far
+        const std::vector<std::string>& leaves() const;
+        bool finish(TreeHash& tree);
+        
+    private:
+        struct State;
+        std::unique_ptr<State> state_;
+    };
+    
+    // "<chunk_size>:<root>:<leaf>,<leaf>,..." as stored in capsule metadata
+    static std::string serializeTreeHash(const TreeHash& tree);
+    static bool parseTreeHash(const std::string& text, TreeHash& tree);
+    
+    // File-based hashing; the progress callback, if set, runs after each
+    // buffer with the bytes hashed so far and the file size
     std::string computeFileSHA256(const std::string& file_path);
     std::string computeFileSHA1(const std::string& file_path);
     std::string computeFileMD5(const std::string& file_path);
     
+    // Batch SHA-256 of independent inputs, hex digests in input order.
+    // Short inputs are hashed eight at a time in SIMD lanes (see
+    // MultiBufferSHA256), long ones one per task; batches of a few MB or
+    // more are spread over `threads` workers (0 = all cores). A file that
+    // cannot be read gets an empty digest.
+    static std::vector<std::string> computeSHA256Batch(const std::vector<std::vector<uint8_t>>& inputs,
+                                                       size_t threads = 0);
+    std::vector<std::string> computeFileSHA256Batch(const std::vector<std::string>& file_paths,
+                                                    size_t threads = 0);
+    
     // Memory-based hashing
     std::string computeSHA256(const std::vector<uint8_t>& data);
     std::string computeSHA256(const std::string& data);
@@ -47,7 +120,10 @@ public:
     void setProgressCallback(ProgressCallback callback);
     
 private:
+    struct State;
+    
     ProgressCallback progress_callback_;
+    std::unique_ptr<State> state_;
     
     // Internal implementations
     std::string computeFileHash(const std::string& file_path, const std::string& algorithm);
@@ -55,6 +131,8 @@ private:
     std::string computeHMAC(const std::vector<uint8_t>& data, 
                            const std::vector<uint8_t>& key, 
                            const std::string& algorithm);
+    bool computeTreeLeaves(const std::string& file_path, size_t chunk_size, size_t threads,
+                           std::vector<std::string>& leaves);
 };
 
-#endif // HASH_UTILS_H
\ No newline at end of file
+#endif // HASH_UTILS_H
@@ -3,31 +3,62 @@
 
 #include <string>
 #include <vector>
-#include <map>
-#include <queue>
 #include <memory>
+#include <cstdint>
+#include <future>
+#include "codec.h"
 
-// Huffman Tree Node
-struct HuffmanNode {
-    uint8_t byte;
-    unsigned frequency;
-    std::shared_ptr<HuffmanNode> left;
-    std::shared_ptr<HuffmanNode> right;
-    
-    HuffmanNode(uint8_t b, unsigned freq) 
-        : byte(b), frequency(freq), left(nullptr), right(nullptr) {}
-    
-    bool isLeaf() const {
-        return left == nullptr && right == nullptr;
-    }
+class ThreadPool;
+
+// Two-level lookup table for decodeData.
+// Primary entries are indexed by the next kPrimaryBits of input; codes longer
+// than that link to a secondary table indexed by the bits that follow.
+struct HuffmanDecodeTable {
+    static constexpr int kPrimaryBits = 11;
+    static constexpr int kMaxCodeLength = 20;   // longer legacy codes use the tree walk
+    
+    // Entry layout:
+    //   leaf: (length << 16) | symbol
+    //   link: kLinkFlag | (sub_bits << 24) | offset of secondary table
+    //   0:    no code starts with these bits
+    static constexpr uint32_t kLinkFlag = 0x80000000u;
+    
+    std::vector<uint32_t> entries;
+    int primary_bits = 0;
+    int max_length = 0;
+};
+
+// Packed codeword: the low `length` bits of `code`, emitted MSB-first
+struct HuffmanCode {
+    uint64_t code = 0;
+    uint8_t length = 0;
 };
 
-// Comparison for priority queue
-struct CompareNodes {
-    bool operator()(const std::shared_ptr<HuffmanNode>& a, 
-                   const std::shared_ptr<HuffmanNode>& b) {
-        return a->frequency > b->frequency;
-    }
+// Block container written by compressFile/compressData:
+//   header  "TCHF" | version(1) | codec(1) | reserved(2) | block_size(4) |
+//           original_size(8)
+//   frames  raw_size(4) | payload_size(4) | crc32(4) | payload, one per block;
+//           a frame with raw_size 0 ends the block list
+//   index   frame_offset(8) | raw_size(4) per block
+//   footer  block_count(4) | index_offset(8) | "TCHI"
+// Each payload is a self-contained block starting with a type byte: stored
+// (raw bytes follow), Huffman, which carries its canonical code lengths
+// (one byte per symbol, zero runs stored as 0 + run-1, at most 20 bits),
+// the exact encoded bit count data_bits(8) and the encoded data, or LZ77,
+// whose literal, length and offset streams (see Lz77Streams) are each
+// stored or Huffman coded the same way. The codec byte records which
+// transform the writer used (CodecId); the block types alone are enough
+// to decode. The CRC-32
+// covers the block's raw bytes. Blocks that would not shrink, or whose
+// sampled entropy says they will not, are stored, so a container is never
+// much larger than its input and decoding them is a copy. Readers can stream
+// frames in order or seek through the index; decoders reject a container
+// whose index or footer does not match the frames they read.
+// All integers are little-endian. Input that does not start with the magic
+// is a single-block file from before the container format.
+struct HuffmanBlockIndexEntry {
+    uint64_t offset;     // frame start, from the beginning of the container
+    uint32_t raw_size;
 };
 
 class HuffmanCompressor {
@@ -37,30 +68,122 @@ public:
     
     // Main compression/decompression functions
     bool compressFile(const std::string& input_file, const std::string& output_file);
+    // Streams the container to `sink` as it is produced (see ByteSink)
+    bool compressFile(const std::string& input_file, const ByteSink& sink);
     bool decompressFile(const std::string& input_file, const std::string& output_file);
     
+    // Decoder for containers that arrive in pieces (see StreamDecompressor),
+    // using this compressor's thread count
+    std::unique_ptr<StreamDecompressor> createStreamDecompressor(const ByteSink& sink) const;
+    
     // Memory-based operations
     bool compressData(const std::vector<uint8_t>& input, std::vector<uint8_t>& output);
     bool decompressData(const std::vector<uint8_t>& input, std::vector<uint8_t>& output);
     
+    // Block size used for new containers (default 1 MB)
+    void setBlockSize(size_t block_size);
+    size_t getBlockSize() const;
+    // Largest container compressData writes for `original_size` bytes in
+    // `block_size` blocks; blocks that coding would not shrink are stored,
+    // so only the framing is added
+    static uint64_t maxContainerSize(uint64_t original_size, size_t block_size = kDefaultBlockSize);
+    
+    // Worker threads for block compression/decompression (0 = all cores)
+    void setThreadCount(size_t thread_count);
+    size_t getThreadCount() const;
+    
+    // Longest code the encoder may assign (default 15, at most
+    // HuffmanDecodeTable::kMaxCodeLength). Shorter limits bound decode
+    // table size at a small cost in ratio on skewed data.
+    void setMaxCodeLength(int max_code_length);
+    int getMaxCodeLength() const;
+    
+    // Sample each block before coding and store it as-is when it looks
+    // incompressible (default on)
+    void setEntropyProbe(bool enabled);
+    bool getEntropyProbe() const;
+    
+    // Blocks written uncompressed by the last compressFile/compressData
+    size_t getStoredBlockCount() const;
+    
+    // Block transform for new containers (default Huffman only) and, for
+    // Lz77Huffman, how many earlier positions each match search may try
+    void setCodec(CodecId codec);
+    CodecId getCodec() const;
+    void setMatchChain(int max_chain);
+    int getMatchChain() const;
+    
+    // Codec named in a compressed file's header
+    static bool readCodec(const std::string& input_file, CodecId& codec);
+    
+    static constexpr int kDefaultMaxCodeLength = 15;
+    static constexpr int kMinCodeLengthLimit = 8;
+    static constexpr size_t kDefaultBlockSize = 1 << 20;
+    static constexpr size_t kMaxBlockSize = 64 << 20;
+    
     // Utility functions
     double getCompressionRatio() const;
     size_t getOriginalSize() const;
     size_t getCompressedSize() const;
     
 private:
+    class StreamDecoder;
+    
+    // Container framing
+    void writeContainerHeader(uint64_t original_size, std::vector<uint8_t>& out) const;
+    bool readContainerHeader(const uint8_t* header, size_t& block_size,
+                             uint64_t& original_size) const;
+    void writeContainerTrailer(const std::vector<HuffmanBlockIndexEntry>& index,
+                               uint64_t index_offset,
+                               std::vector<uint8_t>& out) const;
+    // True when `trailer`, from the terminating frame to the end, is exactly
+    // what writeContainerTrailer writes for the frames a reader decoded
+    bool checkContainerTrailer(const std::vector<HuffmanBlockIndexEntry>& index,
+                               uint64_t index_offset,
+                               const uint8_t* trailer, size_t trailer_size) const;
+    bool compressBlock(const uint8_t* data, size_t size, std::vector<uint8_t>& frame);
+    void encodeStream(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+    bool decodeStream(const uint8_t* payload, size_t payload_size,
+                      uint8_t* output, size_t raw_size);
+    bool decompressBlock(const uint8_t* payload, size_t payload_size,
+                         uint8_t* output, size_t raw_size, uint32_t checksum);
+    std::unique_ptr<ThreadPool> createPool(size_t block_count) const;
+    std::future<std::vector<uint8_t>> submitCompress(ThreadPool* pool,
+                                                     const uint8_t* data,
+                                                     size_t size) const;
+    static std::future<bool> submitDecompress(ThreadPool* pool,
+                                              const uint8_t* payload,
+                                              size_t payload_size,
+                                              uint8_t* output,
+                                              size_t raw_size,
+                                              uint32_t checksum);
+    bool decompressLegacy(const uint8_t* input, size_t input_size, std::vector<uint8_t>& output);
+    
     // Compression functions
-    void buildFrequencyTable(const std::vector<uint8_t>& data);
-    void buildHuffmanTree();
-    void generateCodes(const std::shared_ptr<HuffmanNode>& node, const std::string& code);
-    std::vector<uint8_t> serializeTree();
-    std::vector<uint8_t> encodeData(const std::vector<uint8_t>& data);
+    void buildFrequencyTable(const uint8_t* data, size_t size);
+    void buildCodeLengths();
+    void limitCodeLengths(int max_length);
+    uint64_t encodedBits() const;
+    static void canonicalizeCodes(HuffmanCode codes[256]);
+    void writeCodeLengths(std::vector<uint8_t>& out) const;
+    void encodeData(const uint8_t* data, size_t size, std::vector<uint8_t>& encoded);
     
     // Decompression functions
-    std::shared_ptr<HuffmanNode> deserializeTree(const std::vector<uint8_t>& tree_data, size_t& pos);
-    std::vector<uint8_t> decodeData(const std::vector<uint8_t>& encoded_data, 
-                                   const std::shared_ptr<HuffmanNode>& root,
-                                   size_t data_bits);
+    static bool readCodeLengths(const uint8_t* data, size_t size, size_t& pos,
+                                HuffmanCode codes[256]);
+    static bool deserializeTree(const uint8_t* tree_data, size_t tree_size,
+                                HuffmanCode codes[256]);
+    // Decodes at most output_size symbols into output; returns the count
+    size_t decodeData(const uint8_t* encoded_data, size_t encoded_size,
+                      const HuffmanCode codes[256], uint64_t data_bits,
+                      uint8_t* output, size_t output_size);
+    static bool buildDecodeTable(const HuffmanCode codes[256], HuffmanDecodeTable& table);
+    static std::vector<uint8_t> decodeDataTreeWalk(const uint8_t* encoded_data, size_t encoded_size,
+                                                  const HuffmanCode codes[256],
+                                                  size_t data_bits);
+    
+    // Longest code accepted from a legacy serialized tree
+    static constexpr int kMaxSupportedCodeLength = 48;
     
     // Bit manipulation
     void writeBit(uint8_t bit, std::vector<uint8_t>& buffer, size_t& bit_pos);
@@ -68,12 +191,19 @@ private:
     void writeBits(const std::string& bits, std::vector<uint8_t>& buffer, size_t& bit_pos);
     
     // Member variables
-    std::map<uint8_t, unsigned> frequency_table_;
-    std::map<uint8_t, std::string> huffman_codes_;
-    std::shared_ptr<HuffmanNode> root_;
+    uint32_t frequency_table_[256];  // byte counts of the current block
+    HuffmanCode huffman_codes_[256];
+    HuffmanDecodeTable decode_table_;
     
     size_t original_size_;
     size_t compressed_size_;
+    size_t block_size_;
+    size_t thread_count_;
+    int max_code_length_;
+    bool entropy_probe_;
+    size_t stored_blocks_;
+    CodecId codec_;
+    int match_chain_;
 };
 
 #endif // HUFFMAN_H
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef KDF_H
+#define KDF_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Password-based key derivation with the cost recorded alongside the
+// capsule, so each deployment can choose its own security/latency trade-off.
+enum class KdfAlgorithm : uint8_t {
+    Pbkdf2Sha256 = 0,  // iterations
+    Scrypt = 1         // memory_kib (N = memory_kib, r = 8) and parallelism
+};
+
+struct KdfParams {
+    KdfAlgorithm algorithm = KdfAlgorithm::Pbkdf2Sha256;
+    uint32_t iterations = 100000;
+    uint32_t memory_kib = 0;
+    uint8_t parallelism = 1;
+};
+
+// Parameter block appended to the key package after the IV:
+//   block_size(1) | algorithm(1) | iterations(4) | memory_kib(4) | parallelism(1)
+// Packages without one were derived with PBKDF2-SHA256 and 100,000 iterations.
+const size_t kKdfBlockSize = 10;
+
+const char* kdfName(KdfAlgorithm algorithm);
+bool parseKdfAlgorithm(const std::string& name, KdfAlgorithm& algorithm);
+
+// False when the parameters are outside what a receiver will run: unknown
+// algorithm, PBKDF2 iterations outside 10,000-2^30 (the calibration floor
+// up), or scrypt memory that is not a power of two between 1 MiB and 4 GiB,
+// or parallelism outside 1-16
+bool validateKdfParams(const KdfParams& params);
+
+std::vector<uint8_t> deriveKey(const std::string& password, const std::vector<uint8_t>& salt,
+                               size_t key_size, const KdfParams& params);
+
+void appendKdfBlock(std::vector<uint8_t>& package, const KdfParams& params);
+// Reads the block at `pos`, or the legacy defaults when the package ends there
+bool readKdfBlock(const std::vector<uint8_t>& package, size_t pos, KdfParams& params);
+
+// Times the local machine and returns the cost that makes one derivation
+// take about `target_ms`. PBKDF2 scales its iterations; scrypt doubles its
+// memory, keeping parallelism at 1. Costs never drop below the minimums.
+KdfParams calibrateKdf(KdfAlgorithm algorithm, double target_ms);
+
+#endif // KDF_H
@@ -0,0 +1,50 @@
+#ifndef LZ77_H
+#define LZ77_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// A block parsed into sequences of (literal run, match). Each stream is
+// byte-oriented so it can be entropy coded on its own:
+//   literals  the literal bytes of every sequence, in order
+//   lengths   per sequence: literal_run varint, then (match_length - kMinMatch)
+//             varint; the last sequence has a literal run only
+//   offsets   match distance varint per match
+// Varints are little-endian base 128.
+struct Lz77Streams {
+    std::vector<uint8_t> literals;
+    std::vector<uint8_t> lengths;
+    std::vector<uint8_t> offsets;
+};
+
+// Greedy LZ77 matcher with hash chains over 4-byte prefixes. Matches may
+// reach back to the start of the block; max_chain bounds how many earlier
+// positions are tried per byte.
+class Lz77Matcher {
+public:
+    static constexpr int kMinMatch = 4;
+    static constexpr size_t kMaxMatch = 1 << 16;
+    static constexpr int kDefaultMaxChain = 16;
+    
+    explicit Lz77Matcher(int max_chain = kDefaultMaxChain);
+    
+    void parse(const uint8_t* data, size_t size, Lz77Streams& streams);
+    
+    // Rebuilds exactly `size` bytes; false if the streams are malformed or do
+    // not describe exactly that many bytes
+    static bool expand(const Lz77Streams& streams, uint8_t* output, size_t size);
+
+private:
+    static constexpr int kHashBits = 16;
+    static constexpr size_t kFarMinMatchDistance = 1 << 12;
+    
+    size_t findMatch(const uint8_t* data, size_t pos, size_t size, size_t& distance);
+    void insert(const uint8_t* data, size_t pos);
+    
+    int max_chain_;
+    std::vector<int32_t> head_;
+    std::vector<int32_t> prev_;
+};
+
+#endif // LZ77_H
@@ -0,0 +1,56 @@
+#ifndef RSA_KEY_H
+#define RSA_KEY_H
+
+#include <string>
+#include <memory>
+#include <cstddef>
+
+// A parsed, validated RSA key, shared by every RSACrypto operation that
+// uses it. The PEM is decoded and checked once; a private key keeps its CRT
+// parameters (p, q, d mod p-1, d mod q-1, q^-1 mod p) and both keys keep
+// their OAEP-SHA1 encryptor/decryptor, so an operation only does the modular
+// arithmetic. Decryption is blinded with a fresh factor from a per-thread
+// generator, so one key can be used from several threads at once.
+class RSAKey {
+public:
+    ~RSAKey();
+    
+    // Null when the PEM cannot be parsed or the key fails validation
+    static std::shared_ptr<const RSAKey> fromPem(const std::string& pem, bool is_private);
+    // Reads and parses the key at path. With a key cache enabled, the most
+    // recent `capacity` keys are kept by path and reparsed only when the
+    // file's modification time or size changes; evicted and cleared keys
+    // are zeroized once their last user releases them. Disabled by default.
+    static std::shared_ptr<const RSAKey> loadFromFile(const std::string& path, bool is_private);
+    static void setKeyCacheCapacity(size_t capacity);
+    static void clearKeyCache();
+    
+    // Enables the key cache with at least `capacity` entries for as long as
+    // any scope is alive; the last scope to end clears and disables it
+    class KeyCacheScope {
+    public:
+        explicit KeyCacheScope(size_t capacity);
+        KeyCacheScope(const KeyCacheScope& other);
+        KeyCacheScope& operator=(const KeyCacheScope& other) = default;
+        ~KeyCacheScope();
+        
+    private:
+        size_t capacity_;
+    };
+    
+    bool isPrivate() const;
+    unsigned int modulusBits() const;
+    // Largest plaintext one encryption takes, and the size of every ciphertext
+    size_t maxPlaintextSize() const;
+    size_t ciphertextSize() const;
+
+private:
+    friend class RSACrypto;
+    struct KeyState;
+    
+    explicit RSAKey(std::unique_ptr<KeyState> state);
+    
+    std::unique_ptr<KeyState> state_;
+};
+
+#endif // RSA_KEY_H
@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 
+#include "rsa_key.h"
+
 class RSACrypto {
 public:
     RSACrypto();
@@ -31,6 +33,21 @@ public:
                               const std::string& ciphertext,
                               std::string& plaintext);
     
+    // Operations on a loaded key (see rsa_key.h), which skip the PEM
+    // decoding and key checks the path- and PEM-based forms repeat per call
+    bool encryptFile(const RSAKey& public_key,
+                    const std::vector<uint8_t>& input_data,
+                    const std::string& output_file);
+    bool decryptFile(const RSAKey& private_key,
+                    const std::vector<uint8_t>& encrypted_data,
+                    std::vector<uint8_t>& decrypted_data);
+    bool encryptWithPublicKey(const RSAKey& public_key,
+                             const std::string& plaintext,
+                             std::string& ciphertext);
+    bool decryptWithPrivateKey(const RSAKey& private_key,
+                              const std::string& ciphertext,
+                              std::string& plaintext);
+    
     // Key management
     static bool validatePublicKey(const std::string& public_key_pem);
     static bool validatePrivateKey(const std::string& private_key_pem);
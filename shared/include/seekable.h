@@ -0,0 +1,60 @@
+#ifndef SEEKABLE_H
+#define SEEKABLE_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+#include "codec.h"
+
+// Seekable capsule: the plaintext is cut into fixed-size chunks, and each
+// chunk is compressed and AES-GCM sealed on its own, so any byte range can
+// be recovered from the chunks covering it alone.
+//   header  "TCSK" | version(1) | codec(1) | reserved(2) | chunk_size(4) |
+//           chunk_count(4) | original_size(8) | nonce_prefix(8)
+//   index   per chunk: offset(8) | stored_size(4) | plain_size(4) | tag(16)
+//   data    the sealed chunks, back to back in index order
+// Chunk i uses nonce = nonce_prefix | i (4 bytes, big-endian), and its
+// associated data is the header plus its stored and plain sizes, so edits
+// to the header, the index or the chunks fail verification. Empty files
+// are rejected, so there is always a chunk authenticating the header.
+class SeekableCapsule {
+public:
+    // Reads `length` bytes at `offset` of a capsule into `data`; backs
+    // decryption with a local file or with HTTP range requests
+    typedef std::function<bool(uint64_t offset, size_t length, std::vector<uint8_t>& data)> RangeReader;
+    
+    static constexpr size_t kHeaderSize = 32;
+    static constexpr size_t kIndexEntrySize = 32;
+    static constexpr size_t kDefaultChunkSize = 1 << 20;
+    
+    // Compresses (see createCodecForLevel) and seals `input_file` chunk by
+    // chunk on `threads` workers (0 = all cores). The first 8 IV bytes form
+    // the nonce prefix.
+    static bool encryptFile(const std::string& input_file, const std::string& output_file,
+                            const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv,
+                            int level, size_t threads = 0);
+    
+    // Writes plaintext bytes [offset, offset + length) to `output_file`,
+    // clamped to the end of the original file, reading only the header, the
+    // index and the chunks that overlap the range. The partial output is
+    // removed if any chunk fails verification.
+    static bool decryptRange(const RangeReader& reader, const std::vector<uint8_t>& key,
+                             uint64_t offset, uint64_t length, const std::string& output_file,
+                             size_t threads = 0);
+    static bool decryptFile(const std::string& input_file, const std::string& output_file,
+                            const std::vector<uint8_t>& key, size_t threads = 0);
+    
+    static RangeReader fileReader(const std::string& path);
+    static bool isSeekableFile(const std::string& file_path);
+    // The check isSeekableFile makes on a capsule's first kPrefixSize bytes
+    static constexpr size_t kPrefixSize = 8;
+    static bool isSeekablePrefix(const uint8_t* prefix);
+    
+    // Parses "START-END" (inclusive, as in HTTP Range) or "START-" (to the
+    // end of the file); positions are plaintext byte offsets
+    static bool parseRange(const std::string& text, uint64_t& offset, uint64_t& length);
+};
+
+#endif // SEEKABLE_H
@@ -0,0 +1,31 @@
+#ifndef SHA256_MULTI_H
+#define SHA256_MULTI_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Multi-buffer SHA-256: up to kLanes independent messages hashed together,
+// one per 32-bit lane of an AVX2 register, so eight short messages cost
+// about as much as one. Lanes whose message ends early idle until the
+// longest one finishes, so callers should group messages of similar size.
+// Without AVX2 (checked at run time) the messages are hashed one by one.
+class MultiBufferSHA256 {
+public:
+    static constexpr size_t kLanes = 8;
+    static constexpr size_t kDigestSize = 32;
+    
+    // True when hash() runs the lanes in parallel on this CPU
+    static bool accelerated();
+    
+    // True when a `size`-byte message is cheaper to hash in lanes than on
+    // its own: always with AVX2 alone, only for short messages when the CPU
+    // also has SHA extensions for single-buffer hashing
+    static bool preferred(size_t size);
+    
+    // Hashes messages[i] (sizes[i] bytes) into digests + i * kDigestSize
+    // for i < count <= kLanes
+    static void hash(const uint8_t* const* messages, const size_t* sizes, size_t count,
+                     uint8_t* digests);
+};
+
+#endif // SHA256_MULTI_H
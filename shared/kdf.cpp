@@ -0,0 +1,168 @@
+#include "kdf.h"
+#include "aes_cbc.h"
+#include <cryptopp/scrypt.h>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+using namespace CryptoPP;
+
+namespace {
+
+const uint32_t kMinPbkdf2Iterations = 10000;
+const uint32_t kMaxPbkdf2Iterations = 1u << 30;
+const uint32_t kScryptBlockSize = 8;              // r: 1 KiB of memory per unit of N
+const uint32_t kMinScryptMemoryKib = 1 << 10;     // 1 MiB
+const uint32_t kMaxScryptMemoryKib = 1u << 22;    // 4 GiB
+const uint32_t kCalibrationScryptMemoryKib = 1 << 12;
+const uint8_t kMaxParallelism = 16;
+
+bool isPowerOfTwo(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+void putU32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint32_t getU32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Milliseconds one derivation with `params` takes here. The salt changes
+// per call so an enabled PBKDF2 key cache cannot answer instead.
+double timeDerivation(const KdfParams& params) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t ticks = static_cast<uint64_t>(start.time_since_epoch().count());
+    std::vector<uint8_t> salt(16);
+    for (size_t i = 0; i < salt.size(); i++) {
+        salt[i] = static_cast<uint8_t>(ticks >> (8 * (i % 8)));
+    }
+    deriveKey("calibration", salt, 32, params);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+} // namespace
+
+const char* kdfName(KdfAlgorithm algorithm) {
+    switch (algorithm) {
+        case KdfAlgorithm::Pbkdf2Sha256: return "pbkdf2";
+        case KdfAlgorithm::Scrypt: return "scrypt";
+    }
+    return "unknown";
+}
+
+bool parseKdfAlgorithm(const std::string& name, KdfAlgorithm& algorithm) {
+    if (name == "pbkdf2") {
+        algorithm = KdfAlgorithm::Pbkdf2Sha256;
+        return true;
+    }
+    if (name == "scrypt") {
+        algorithm = KdfAlgorithm::Scrypt;
+        return true;
+    }
+    return false;
+}
+
+bool validateKdfParams(const KdfParams& params) {
+    switch (params.algorithm) {
+        case KdfAlgorithm::Pbkdf2Sha256:
+            return params.iterations >= kMinPbkdf2Iterations && params.iterations <= kMaxPbkdf2Iterations;
+        case KdfAlgorithm::Scrypt:
+            return isPowerOfTwo(params.memory_kib) && params.memory_kib >= kMinScryptMemoryKib &&
+                   params.memory_kib <= kMaxScryptMemoryKib &&
+                   params.parallelism >= 1 && params.parallelism <= kMaxParallelism;
+    }
+    return false;
+}
+
+std::vector<uint8_t> deriveKey(const std::string& password, const std::vector<uint8_t>& salt,
+                               size_t key_size, const KdfParams& params) {
+    if (!validateKdfParams(params)) {
+        std::cerr << "Invalid " << kdfName(params.algorithm) << " parameters" << std::endl;
+        return {};
+    }
+    
+    if (params.algorithm == KdfAlgorithm::Pbkdf2Sha256) {
+        return AESCrypto::deriveKeyPBKDF2(password, salt, key_size, static_cast<int>(params.iterations));
+    }
+    
+    try {
+        std::vector<uint8_t> key(key_size);
+        Scrypt scrypt;
+        scrypt.DeriveKey(key.data(), key.size(),
+                         reinterpret_cast<const byte*>(password.data()), password.size(),
+                         salt.data(), salt.size(),
+                         params.memory_kib, kScryptBlockSize, params.parallelism);
+        return key;
+    } catch (const std::exception& e) {
+        std::cerr << "scrypt error: " << e.what() << std::endl;
+        return {};
+    }
+}
+
+void appendKdfBlock(std::vector<uint8_t>& package, const KdfParams& params) {
+    uint8_t block[kKdfBlockSize + 1];
+    block[0] = static_cast<uint8_t>(kKdfBlockSize);
+    block[1] = static_cast<uint8_t>(params.algorithm);
+    putU32(block + 2, params.iterations);
+    putU32(block + 6, params.memory_kib);
+    block[10] = params.parallelism;
+    package.insert(package.end(), block, block + sizeof(block));
+}
+
+bool readKdfBlock(const std::vector<uint8_t>& package, size_t pos, KdfParams& params) {
+    params = KdfParams();
+    if (pos == package.size()) {
+        return true;
+    }
+    
+    if (pos + 1 + kKdfBlockSize > package.size() || package[pos] != kKdfBlockSize) {
+        std::cerr << "Malformed KDF parameter block in key package" << std::endl;
+        return false;
+    }
+    const uint8_t* block = package.data() + pos + 1;
+    params.algorithm = static_cast<KdfAlgorithm>(block[0]);
+    params.iterations = getU32(block + 1);
+    params.memory_kib = getU32(block + 5);
+    params.parallelism = block[9];
+    if (!validateKdfParams(params)) {
+        std::cerr << "Unsupported KDF parameters in key package" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+KdfParams calibrateKdf(KdfAlgorithm algorithm, double target_ms) {
+    KdfParams params;
+    params.algorithm = algorithm;
+    
+    if (algorithm == KdfAlgorithm::Pbkdf2Sha256) {
+        // Cost is linear in iterations; time a probe and scale it
+        KdfParams probe = params;
+        probe.iterations = kMinPbkdf2Iterations;
+        double probe_ms = std::max(timeDerivation(probe), 0.001);
+        double iterations = kMinPbkdf2Iterations * target_ms / probe_ms;
+        params.iterations = static_cast<uint32_t>(std::min<double>(
+            std::max<double>(iterations, kMinPbkdf2Iterations), kMaxPbkdf2Iterations));
+        params.iterations -= params.iterations % 1000;
+        return params;
+    }
+    
+    // scrypt cost is linear in memory; keep doubling while the estimate
+    // for the next size stays within the budget
+    params.iterations = 1;
+    params.memory_kib = kCalibrationScryptMemoryKib;
+    params.parallelism = 1;
+    double ms_per_kib = std::max(timeDerivation(params), 0.001) / params.memory_kib;
+    params.memory_kib = kMinScryptMemoryKib;
+    while (params.memory_kib < kMaxScryptMemoryKib &&
+           ms_per_kib * params.memory_kib * 2 <= target_ms) {
+        params.memory_kib *= 2;
+    }
+    return params;
+}
@@ -0,0 +1,175 @@
+#include "lz77.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+void putVarint(std::vector<uint8_t>& out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool getVarint(const std::vector<uint8_t>& in, size_t& pos, size_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= in.size()) {
+            return false;
+        }
+        uint8_t byte = in[pos++];
+        value |= static_cast<size_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Length of the common prefix of a and b, at most max_length bytes
+size_t matchLength(const uint8_t* a, const uint8_t* b, size_t max_length) {
+    size_t length = 0;
+    while (length + 8 <= max_length) {
+        uint64_t x, y;
+        std::memcpy(&x, a + length, sizeof(x));
+        std::memcpy(&y, b + length, sizeof(y));
+        if (x != y) {
+            return length + (__builtin_ctzll(x ^ y) >> 3);
+        }
+        length += 8;
+    }
+    while (length < max_length && a[length] == b[length]) {
+        length++;
+    }
+    return length;
+}
+
+} // namespace
+
+Lz77Matcher::Lz77Matcher(int max_chain)
+    : max_chain_(std::max(1, max_chain)) {
+}
+
+void Lz77Matcher::insert(const uint8_t* data, size_t pos) {
+    uint32_t hash = (read32(data + pos) * 2654435761u) >> (32 - kHashBits);
+    prev_[pos] = head_[hash];
+    head_[hash] = static_cast<int32_t>(pos);
+}
+
+size_t Lz77Matcher::findMatch(const uint8_t* data, size_t pos, size_t size, size_t& distance) {
+    uint32_t hash = (read32(data + pos) * 2654435761u) >> (32 - kHashBits);
+    int32_t candidate = head_[hash];
+    prev_[pos] = candidate;
+    head_[hash] = static_cast<int32_t>(pos);
+    
+    const size_t max_length = std::min(size - pos, kMaxMatch);
+    size_t best_length = 0;
+    for (int chain = max_chain_; candidate >= 0 && chain > 0; chain--) {
+        const uint8_t* match = data + candidate;
+        // A longer match must also differ from the best one at its last byte
+        if (match[best_length] == data[pos + best_length]) {
+            size_t length = matchLength(match, data + pos, max_length);
+            if (length > best_length) {
+                best_length = length;
+                distance = pos - candidate;
+                if (length == max_length) {
+                    break;
+                }
+            }
+        }
+        candidate = prev_[candidate];
+    }
+    return best_length;
+}
+
+void Lz77Matcher::parse(const uint8_t* data, size_t size, Lz77Streams& streams) {
+    streams.literals.clear();
+    streams.lengths.clear();
+    streams.offsets.clear();
+    streams.literals.reserve(size / 2);
+    
+    head_.assign(size_t(1) << kHashBits, -1);
+    prev_.resize(size);
+    
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (size >= kMinMatch && pos <= size - kMinMatch) {
+        size_t distance = 0;
+        size_t length = findMatch(data, pos, size, distance);
+        // A minimum-length match far back costs about as much as its literals
+        if (length < static_cast<size_t>(kMinMatch) ||
+            (length == static_cast<size_t>(kMinMatch) && distance > kFarMinMatchDistance)) {
+            pos++;
+            continue;
+        }
+        
+        putVarint(streams.lengths, pos - anchor);
+        streams.literals.insert(streams.literals.end(), data + anchor, data + pos);
+        putVarint(streams.lengths, length - kMinMatch);
+        putVarint(streams.offsets, distance);
+        
+        // Later matches may start anywhere inside this one
+        size_t end = pos + length;
+        for (pos++; pos < end && pos <= size - kMinMatch; pos++) {
+            insert(data, pos);
+        }
+        pos = end;
+        anchor = end;
+    }
+    
+    putVarint(streams.lengths, size - anchor);
+    streams.literals.insert(streams.literals.end(), data + anchor, data + size);
+}
+
+bool Lz77Matcher::expand(const Lz77Streams& streams, uint8_t* output, size_t size) {
+    size_t literal_pos = 0;
+    size_t length_pos = 0;
+    size_t offset_pos = 0;
+    size_t out = 0;
+    
+    while (true) {
+        size_t run;
+        if (!getVarint(streams.lengths, length_pos, run) ||
+            run > size - out || run > streams.literals.size() - literal_pos) {
+            return false;
+        }
+        std::memcpy(output + out, streams.literals.data() + literal_pos, run);
+        literal_pos += run;
+        out += run;
+        
+        if (length_pos == streams.lengths.size()) {
+            break; // Final sequence has no match
+        }
+        
+        size_t length, distance;
+        if (!getVarint(streams.lengths, length_pos, length) ||
+            !getVarint(streams.offsets, offset_pos, distance)) {
+            return false;
+        }
+        length += kMinMatch;
+        if (distance == 0 || distance > out || length > size - out) {
+            return false;
+        }
+        
+        const uint8_t* match = output + out - distance;
+        if (distance >= length) {
+            std::memcpy(output + out, match, length);
+        } else {
+            // Overlapping copy repeats the last `distance` bytes
+            for (size_t i = 0; i < length; i++) {
+                output[out + i] = match[i];
+            }
+        }
+        out += length;
+    }
+    
+    return out == size && literal_pos == streams.literals.size() &&
+           offset_pos == streams.offsets.size();
+}
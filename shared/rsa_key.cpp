@@ -0,0 +1,311 @@
+#include "rsa_key.h"
+#include "rsa_utils.h"
+#include <cryptopp/rsa.h>
+#include <cryptopp/osrng.h>
+#include <cryptopp/filters.h>
+#include <cryptopp/pem.h>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <cstdint>
+#include <cstdio>
+#include <sys/stat.h>
+
+using namespace CryptoPP;
+
+struct RSAKey::KeyState {
+    explicit KeyState(const RSA::PrivateKey& key)
+        : is_private(true), encryptor(RSA::PublicKey(key)), decryptor(key) {}
+    explicit KeyState(const RSA::PublicKey& key)
+        : is_private(false), encryptor(key) {}
+    
+    bool is_private;
+    RSAES_OAEP_SHA_Encryptor encryptor;
+    RSAES_OAEP_SHA_Decryptor decryptor; // Keyless for public keys
+};
+
+namespace {
+
+// OAEP seeds and blinding factors. AutoSeededRandomPool is not safe to
+// share, so each thread seeds its own on first use.
+AutoSeededRandomPool& threadRng() {
+    thread_local AutoSeededRandomPool rng;
+    return rng;
+}
+
+// Parsed keys, most recently used first
+struct CachedRSAKey {
+    std::string path;
+    bool is_private;
+    int64_t mtime_ns;
+    int64_t size;
+    std::shared_ptr<const RSAKey> key;
+};
+
+std::mutex rsa_key_cache_mutex;
+std::list<CachedRSAKey> rsa_key_cache;
+size_t rsa_key_cache_capacity = 0;
+size_t rsa_key_cache_scopes = 0;
+
+int64_t modificationTime(const struct stat& info) {
+#ifdef __linux__
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#else
+    return static_cast<int64_t>(info.st_mtime) * 1000000000;
+#endif
+}
+
+} // namespace
+
+RSAKey::RSAKey(std::unique_ptr<KeyState> state) : state_(std::move(state)) {
+}
+
+RSAKey::~RSAKey() {
+}
+
+std::shared_ptr<const RSAKey> RSAKey::fromPem(const std::string& pem, bool is_private) {
+    try {
+        std::unique_ptr<KeyState> state;
+        StringSource source(pem, true);
+        
+        // Level 3 also tests p and q for primality, which is why keys are
+        // worth parsing only once
+        if (is_private) {
+            RSA::PrivateKey key;
+            PEM_Load(source, key);
+            if (!key.Validate(threadRng(), 3)) {
+                std::cerr << "RSA private key failed validation" << std::endl;
+                return nullptr;
+            }
+            state.reset(new KeyState(key));
+        } else {
+            RSA::PublicKey key;
+            PEM_Load(source, key);
+            if (!key.Validate(threadRng(), 3)) {
+                std::cerr << "RSA public key failed validation" << std::endl;
+                return nullptr;
+            }
+            state.reset(new KeyState(key));
+        }
+        
+        return std::shared_ptr<const RSAKey>(new RSAKey(std::move(state)));
+    
+    } catch (const std::exception& e) {
+        std::cerr << "RSA key parsing error: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+std::shared_ptr<const RSAKey> RSAKey::loadFromFile(const std::string& path, bool is_private) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        std::cerr << "Cannot open key file: " << path << std::endl;
+        return nullptr;
+    }
+    int64_t mtime_ns = modificationTime(info);
+    int64_t size = static_cast<int64_t>(info.st_size);
+    
+    {
+        std::lock_guard<std::mutex> lock(rsa_key_cache_mutex);
+        for (auto it = rsa_key_cache.begin(); it != rsa_key_cache.end(); ++it) {
+            if (it->path != path || it->is_private != is_private) {
+                continue;
+            }
+            if (it->mtime_ns == mtime_ns && it->size == size) {
+                rsa_key_cache.splice(rsa_key_cache.begin(), rsa_key_cache, it);
+                return it->key;
+            }
+            rsa_key_cache.erase(it);
+            break;
+        }
+    }
+    
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot open key file: " << path << std::endl;
+        return nullptr;
+    }
+    std::string pem((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    
+    std::shared_ptr<const RSAKey> key = fromPem(pem, is_private);
+    if (!key) {
+        std::cerr << "Invalid RSA key file: " << path << std::endl;
+        return nullptr;
+    }
+    
+    std::lock_guard<std::mutex> lock(rsa_key_cache_mutex);
+    if (rsa_key_cache_capacity > 0) {
+        // Another thread may have loaded the same file meanwhile
+        rsa_key_cache.remove_if([&](const CachedRSAKey& entry) {
+            return entry.path == path && entry.is_private == is_private;
+        });
+        rsa_key_cache.push_front(CachedRSAKey{path, is_private, mtime_ns, size, key});
+        while (rsa_key_cache.size() > rsa_key_cache_capacity) {
+            rsa_key_cache.pop_back();
+        }
+    }
+    return key;
+}
+
+void RSAKey::setKeyCacheCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(rsa_key_cache_mutex);
+    rsa_key_cache_capacity = capacity;
+    while (rsa_key_cache.size() > rsa_key_cache_capacity) {
+        rsa_key_cache.pop_back();
+    }
+}
+
+void RSAKey::clearKeyCache() {
+    std::lock_guard<std::mutex> lock(rsa_key_cache_mutex);
+    rsa_key_cache.clear();
+}
+
+RSAKey::KeyCacheScope::KeyCacheScope(size_t capacity) : capacity_(capacity) {
+    std::lock_guard<std::mutex> lock(rsa_key_cache_mutex);
+    rsa_key_cache_scopes++;
+    rsa_key_cache_capacity = std::max(rsa_key_cache_capacity, capacity);
+}
+
+RSAKey::KeyCacheScope::KeyCacheScope(const KeyCacheScope& other) : KeyCacheScope(other.capacity_) {
+}
+
+RSAKey::KeyCacheScope::~KeyCacheScope() {
+    std::lock_guard<std::mutex> lock(rsa_key_cache_mutex);
+    if (--rsa_key_cache_scopes == 0) {
+        rsa_key_cache.clear();
+        rsa_key_cache_capacity = 0;
+    }
+}
+
+bool RSAKey::isPrivate() const {
+    return state_->is_private;
+}
+
+unsigned int RSAKey::modulusBits() const {
+    return state_->encryptor.GetKey().GetModulus().BitCount();
+}
+
+size_t RSAKey::maxPlaintextSize() const {
+    return state_->encryptor.FixedMaxPlaintextLength();
+}
+
+size_t RSAKey::ciphertextSize() const {
+    return state_->encryptor.FixedCiphertextLength();
+}
+
+// RSACrypto operations on loaded keys, using OAEP with SHA-1
+// (RSAES_OAEP_SHA)
+
+bool RSACrypto::encryptFile(const RSAKey& public_key,
+                           const std::vector<uint8_t>& input_data,
+                           const std::string& output_file) {
+    try {
+        std::string ciphertext;
+        std::string plaintext(input_data.begin(), input_data.end());
+        
+        if (!encryptWithPublicKey(public_key, plaintext, ciphertext)) {
+            return false;
+        }
+        
+        std::ofstream out_file(output_file, std::ios::binary);
+        if (!out_file) {
+            std::cerr << "Cannot create output file: " << output_file << std::endl;
+            return false;
+        }
+        
+        out_file.write(ciphertext.data(), ciphertext.size());
+        out_file.close();
+        if (out_file.fail()) {
+            std::remove(output_file.c_str());
+            std::cerr << "Failed to write key package: " << output_file << std::endl;
+            return false;
+        }
+        
+        return true;
+    
+    } catch (const std::exception& e) {
+        std::cerr << "File encryption error: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool RSACrypto::decryptFile(const RSAKey& private_key,
+                           const std::vector<uint8_t>& encrypted_data,
+                           std::vector<uint8_t>& decrypted_data) {
+    try {
+        std::string plaintext;
+        std::string ciphertext(encrypted_data.begin(), encrypted_data.end());
+        
+        if (!decryptWithPrivateKey(private_key, ciphertext, plaintext)) {
+            return false;
+        }
+        
+        decrypted_data.assign(plaintext.begin(), plaintext.end());
+        return true;
+    
+    } catch (const std::exception& e) {
+        std::cerr << "File decryption error: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool RSACrypto::encryptWithPublicKey(const RSAKey& public_key,
+                                    const std::string& plaintext,
+                                    std::string& ciphertext) {
+    try {
+        const RSAES_OAEP_SHA_Encryptor& encryptor = public_key.state_->encryptor;
+        if (plaintext.size() > encryptor.FixedMaxPlaintextLength()) {
+            std::cerr << "Data too large for RSA key: " << plaintext.size() << " bytes (max "
+                      << encryptor.FixedMaxPlaintextLength() << ")" << std::endl;
+            return false;
+        }
+        
+        ciphertext.resize(encryptor.FixedCiphertextLength());
+        encryptor.Encrypt(threadRng(), reinterpret_cast<const byte*>(plaintext.data()), plaintext.size(),
+                          reinterpret_cast<byte*>(&ciphertext[0]));
+        return true;
+    
+    } catch (const std::exception& e) {
+        std::cerr << "RSA encryption error: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool RSACrypto::decryptWithPrivateKey(const RSAKey& private_key,
+                                     const std::string& ciphertext,
+                                     std::string& plaintext) {
+    try {
+        if (!private_key.isPrivate()) {
+            std::cerr << "RSA decryption needs a private key" << std::endl;
+            return false;
+        }
+        
+        const RSAES_OAEP_SHA_Decryptor& decryptor = private_key.state_->decryptor;
+        if (ciphertext.size() != decryptor.FixedCiphertextLength()) {
+            std::cerr << "RSA ciphertext has the wrong size: " << ciphertext.size() << " bytes (expected "
+                      << decryptor.FixedCiphertextLength() << ")" << std::endl;
+            return false;
+        }
+        
+        plaintext.resize(decryptor.FixedMaxPlaintextLength());
+        DecodingResult result = decryptor.Decrypt(threadRng(),
+                                                  reinterpret_cast<const byte*>(ciphertext.data()),
+                                                  ciphertext.size(),
+                                                  reinterpret_cast<byte*>(&plaintext[0]));
+        if (!result.isValidCoding) {
+            std::cerr << "RSA decryption failed: invalid padding" << std::endl;
+            plaintext.clear();
+            return false;
+        }
+        
+        plaintext.resize(result.messageLength);
+        return true;
+    
+    } catch (const std::exception& e) {
+        std::cerr << "RSA decryption error: " << e.what() << std::endl;
+        return false;
+    }
+}
@@ -0,0 +1,267 @@
+#include "sha256_multi.h"
+#include <cryptopp/sha.h>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SHA256_MULTI_AVX2 1
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+namespace {
+
+void hashEach(const uint8_t* const* messages, const size_t* sizes, size_t count, uint8_t* digests) {
+    CryptoPP::SHA256 hash;
+    for (size_t i = 0; i < count; i++) {
+        hash.Update(messages[i], sizes[i]);
+        hash.Final(digests + i * MultiBufferSHA256::kDigestSize);
+    }
+}
+
+#ifdef SHA256_MULTI_AVX2
+
+const uint32_t kRoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const uint32_t kInitialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+const size_t kBlockSize = 64;
+
+// With SHA extensions one message at a time runs at around 1 GB/s, which
+// eight AVX2 lanes only beat while per-message setup dominates
+const size_t kShortMessageSize = 1024;
+
+bool hasShaExtensions() {
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA);
+}
+
+// Message bytes past the last whole block, followed by SHA-256 padding;
+// one or two blocks
+struct LaneTail {
+    uint8_t blocks[2 * kBlockSize];
+    size_t block_count;
+};
+
+void padTail(const uint8_t* message, size_t size, LaneTail& tail) {
+    size_t remainder = size % kBlockSize;
+    std::memset(tail.blocks, 0, sizeof(tail.blocks));
+    if (remainder > 0) {
+        std::memcpy(tail.blocks, message + size - remainder, remainder);
+    }
+    tail.blocks[remainder] = 0x80;
+    tail.block_count = remainder + 9 <= kBlockSize ? 1 : 2;
+    uint64_t bits = static_cast<uint64_t>(size) * 8;
+    uint8_t* end = tail.blocks + tail.block_count * kBlockSize;
+    for (int i = 1; i <= 8; i++) {
+        end[-i] = static_cast<uint8_t>(bits >> (8 * (i - 1)));
+    }
+}
+
+__attribute__((target("avx2")))
+inline __m256i rotr(__m256i x, int n) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+// Loads word `half * 8 + j` of each lane's block into words[j], byte
+// swapped to big-endian order: an 8x8 transpose of 32-bit words
+__attribute__((target("avx2")))
+void loadWords(const uint8_t* const* blocks, int half, __m256i* words) {
+    const __m256i swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    __m256i rows[8];
+    for (int lane = 0; lane < 8; lane++) {
+        rows[lane] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks[lane] + half * 32));
+    }
+    
+    __m256i t0 = _mm256_unpacklo_epi32(rows[0], rows[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(rows[0], rows[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(rows[2], rows[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(rows[2], rows[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(rows[4], rows[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(rows[4], rows[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(rows[6], rows[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(rows[6], rows[7]);
+    
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+    
+    words[0] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u0, u4, 0x20), swap);
+    words[1] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u1, u5, 0x20), swap);
+    words[2] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u2, u6, 0x20), swap);
+    words[3] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u3, u7, 0x20), swap);
+    words[4] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u0, u4, 0x31), swap);
+    words[5] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u1, u5, 0x31), swap);
+    words[6] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u2, u6, 0x31), swap);
+    words[7] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u3, u7, 0x31), swap);
+}
+
+// One SHA-256 compression per lane; the message schedule is kept as a
+// rolling window of 16 words
+__attribute__((target("avx2")))
+void compressBlocks(__m256i* state, const uint8_t* const* blocks) {
+    __m256i w[16];
+    loadWords(blocks, 0, w);
+    loadWords(blocks, 1, w + 8);
+    
+    __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+    __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+    
+    for (int t = 0; t < 64; t++) {
+        __m256i word;
+        if (t < 16) {
+            word = w[t];
+        } else {
+            __m256i w15 = w[(t - 15) & 15];
+            __m256i w2 = w[(t - 2) & 15];
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr(w15, 7), rotr(w15, 18)),
+                                          _mm256_srli_epi32(w15, 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr(w2, 17), rotr(w2, 19)),
+                                          _mm256_srli_epi32(w2, 10));
+            word = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0),
+                                    _mm256_add_epi32(w[(t - 7) & 15], s1));
+            w[t & 15] = word;
+        }
+        
+        __m256i sum1 = _mm256_xor_si256(_mm256_xor_si256(rotr(e, 6), rotr(e, 11)), rotr(e, 25));
+        __m256i choose = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i temp1 = _mm256_add_epi32(_mm256_add_epi32(h, sum1),
+                                         _mm256_add_epi32(choose, _mm256_add_epi32(
+                                             word, _mm256_set1_epi32(static_cast<int>(kRoundConstants[t])))));
+        __m256i sum0 = _mm256_xor_si256(_mm256_xor_si256(rotr(a, 2), rotr(a, 13)), rotr(a, 22));
+        __m256i majority = _mm256_or_si256(_mm256_and_si256(_mm256_or_si256(a, b), c),
+                                           _mm256_and_si256(a, b));
+        __m256i temp2 = _mm256_add_epi32(sum0, majority);
+        
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, temp1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(temp1, temp2);
+    }
+    
+    state[0] = _mm256_add_epi32(state[0], a);
+    state[1] = _mm256_add_epi32(state[1], b);
+    state[2] = _mm256_add_epi32(state[2], c);
+    state[3] = _mm256_add_epi32(state[3], d);
+    state[4] = _mm256_add_epi32(state[4], e);
+    state[5] = _mm256_add_epi32(state[5], f);
+    state[6] = _mm256_add_epi32(state[6], g);
+    state[7] = _mm256_add_epi32(state[7], h);
+}
+
+__attribute__((target("avx2")))
+void hashLanes(const uint8_t* const* messages, const size_t* sizes, size_t count, uint8_t* digests) {
+    static const uint8_t idle_block[kBlockSize] = {0};
+    
+    LaneTail tails[8];
+    size_t full_blocks[8] = {0};
+    size_t total_blocks[8] = {0};
+    size_t longest = 0;
+    for (size_t lane = 0; lane < count; lane++) {
+        padTail(messages[lane], sizes[lane], tails[lane]);
+        full_blocks[lane] = sizes[lane] / kBlockSize;
+        total_blocks[lane] = full_blocks[lane] + tails[lane].block_count;
+        longest = std::max(longest, total_blocks[lane]);
+    }
+    
+    __m256i state[8];
+    for (int i = 0; i < 8; i++) {
+        state[i] = _mm256_set1_epi32(static_cast<int>(kInitialState[i]));
+    }
+    
+    // Lanes that have run out of blocks hash an idle block and keep their
+    // previous state
+    const uint8_t* blocks[8];
+    for (size_t block = 0; block < longest; block++) {
+        alignas(32) uint32_t active[8];
+        for (size_t lane = 0; lane < 8; lane++) {
+            if (block < full_blocks[lane]) {
+                blocks[lane] = messages[lane] + block * kBlockSize;
+            } else if (block < total_blocks[lane]) {
+                blocks[lane] = tails[lane].blocks + (block - full_blocks[lane]) * kBlockSize;
+            } else {
+                blocks[lane] = idle_block;
+            }
+            active[lane] = block < total_blocks[lane] ? 0xffffffffu : 0;
+        }
+        
+        __m256i mask = _mm256_load_si256(reinterpret_cast<const __m256i*>(active));
+        __m256i next[8];
+        std::memcpy(next, state, sizeof(state));
+        compressBlocks(next, blocks);
+        for (int i = 0; i < 8; i++) {
+            state[i] = _mm256_blendv_epi8(state[i], next[i], mask);
+        }
+    }
+    
+    alignas(32) uint32_t words[8][8];
+    for (int i = 0; i < 8; i++) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(words[i]), state[i]);
+    }
+    for (size_t lane = 0; lane < count; lane++) {
+        uint8_t* digest = digests + lane * MultiBufferSHA256::kDigestSize;
+        for (int i = 0; i < 8; i++) {
+            uint32_t word = words[i][lane];
+            digest[4 * i] = static_cast<uint8_t>(word >> 24);
+            digest[4 * i + 1] = static_cast<uint8_t>(word >> 16);
+            digest[4 * i + 2] = static_cast<uint8_t>(word >> 8);
+            digest[4 * i + 3] = static_cast<uint8_t>(word);
+        }
+    }
+}
+
+#endif // SHA256_MULTI_AVX2
+
+} // namespace
+
+bool MultiBufferSHA256::accelerated() {
+#ifdef SHA256_MULTI_AVX2
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+#else
+    return false;
+#endif
+}
+
+bool MultiBufferSHA256::preferred(size_t size) {
+#ifdef SHA256_MULTI_AVX2
+    static const bool has_sha = hasShaExtensions();
+    return accelerated() && (!has_sha || size <= kShortMessageSize);
+#else
+    (void)size;
+    return false;
+#endif
+}
+
+void MultiBufferSHA256::hash(const uint8_t* const* messages, const size_t* sizes, size_t count,
+                             uint8_t* digests) {
+    count = std::min(count, kLanes);
+#ifdef SHA256_MULTI_AVX2
+    if (count > 1 && accelerated()) {
+        hashLanes(messages, sizes, count, digests);
+        return;
+    }
+#endif
+    hashEach(messages, sizes, count, digests);
+}
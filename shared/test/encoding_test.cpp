@@ -0,0 +1,175 @@
+// Hex and base64 codec test.
+// Checks Encoding against a plain table-driven reference at every length
+// up to a few hundred bytes, so both the SSSE3 blocks and the scalar tail
+// are covered, then substitutes every byte value at positions inside and
+// after the SIMD-decoded prefix and checks that exactly the alphabet is
+// accepted. Also pins padding, trailing-bit and length rules.
+//
+//   make test             (from sender/)
+//   ./encoding_test
+
+#include "encoding.h"
+
+#include <cctype>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char kBase64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const char kHexAlphabet[] = "0123456789abcdef";
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    std::cout << (ok ? "PASS  " : "FAIL  ") << what << std::endl;
+    if (!ok) {
+        failures++;
+    }
+}
+
+std::string referenceHex(const std::vector<uint8_t>& data) {
+    std::string hex;
+    for (uint8_t byte : data) {
+        hex += kHexAlphabet[byte >> 4];
+        hex += kHexAlphabet[byte & 0x0f];
+    }
+    return hex;
+}
+
+std::string referenceBase64(const std::vector<uint8_t>& data) {
+    std::string text;
+    for (size_t i = 0; i < data.size(); i += 3) {
+        uint32_t group = static_cast<uint32_t>(data[i]) << 16;
+        if (i + 1 < data.size()) {
+            group |= static_cast<uint32_t>(data[i + 1]) << 8;
+        }
+        if (i + 2 < data.size()) {
+            group |= data[i + 2];
+        }
+        text += kBase64Alphabet[group >> 18];
+        text += kBase64Alphabet[(group >> 12) & 0x3f];
+        text += i + 1 < data.size() ? kBase64Alphabet[(group >> 6) & 0x3f] : '=';
+        text += i + 2 < data.size() ? kBase64Alphabet[group & 0x3f] : '=';
+    }
+    return text;
+}
+
+bool isHexDigit(int c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+bool isBase64Digit(int c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+           c == '+' || c == '/';
+}
+
+bool hexDecodes(const std::string& hex) {
+    std::vector<uint8_t> out(hex.size() / 2 + 1);
+    return Encoding::hexDecode(hex.data(), hex.size(), out.data());
+}
+
+bool base64Decodes(const std::string& text) {
+    std::vector<uint8_t> out(Encoding::base64DecodedMaxSize(text.size()) + 1);
+    size_t out_size = 0;
+    return Encoding::base64Decode(text.data(), text.size(), out.data(), out_size);
+}
+
+void testRoundTrips(std::mt19937& rng) {
+    size_t hex_failures = 0;
+    size_t base64_failures = 0;
+    for (size_t size = 0; size <= 300; size++) {
+        std::vector<uint8_t> data(size);
+        for (uint8_t& byte : data) {
+            byte = static_cast<uint8_t>(rng());
+        }
+        
+        std::string hex = Encoding::toHex(data);
+        std::string upper = hex;
+        for (char& c : upper) {
+            c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        }
+        if (hex != referenceHex(data) || Encoding::fromHex(hex) != data || Encoding::fromHex(upper) != data) {
+            hex_failures++;
+        }
+        
+        std::string text = Encoding::toBase64(data);
+        std::string unpadded = text.substr(0, text.find('='));
+        if (text != referenceBase64(data) || Encoding::fromBase64(text) != data ||
+            Encoding::fromBase64(unpadded) != data) {
+            base64_failures++;
+        }
+    }
+    check(hex_failures == 0, "hex round trips match the reference for 0-300 bytes");
+    check(base64_failures == 0, "base64 round trips match the reference for 0-300 bytes");
+}
+
+// Puts every byte value at several positions of a valid encoding of 120
+// bytes and checks that only alphabet characters are accepted
+void testSubstitutions(std::mt19937& rng) {
+    std::vector<uint8_t> data(120);
+    for (uint8_t& byte : data) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    std::string hex = Encoding::toHex(data);
+    std::string text = Encoding::toBase64(data);
+    
+    // Inside the first SIMD block, inside a later one, and in the scalar tail
+    for (size_t pos : std::vector<size_t>{0, 5, 21, 47, hex.size() - 1}) {
+        size_t wrong = 0;
+        for (int c = 0; c < 256; c++) {
+            std::string bad = hex;
+            bad[pos] = static_cast<char>(c);
+            if (hexDecodes(bad) != isHexDigit(c)) {
+                wrong++;
+            }
+        }
+        check(wrong == 0, "hex accepts only hex digits at position " + std::to_string(pos));
+    }
+    for (size_t pos : std::vector<size_t>{0, 7, 19, 40, text.size() - 3}) {
+        size_t wrong = 0;
+        for (int c = 0; c < 256; c++) {
+            std::string bad = text;
+            bad[pos] = static_cast<char>(c);
+            if (base64Decodes(bad) != isBase64Digit(c)) {
+                wrong++;
+            }
+        }
+        check(wrong == 0, "base64 accepts only the alphabet at position " + std::to_string(pos));
+    }
+    
+    // Padding in the middle of a long string, where the SIMD blocks stop
+    check(!base64Decodes(text.substr(0, 8) + "==" + text.substr(10)), "base64 rejects padding in the prefix");
+    check(!base64Decodes(text.substr(0, 36) + "QQ==" + text.substr(36)), "base64 rejects a padded inner group");
+}
+
+void testRules() {
+    check(base64Decodes("QQ==") && base64Decodes("QUI=") && base64Decodes("QQ") && base64Decodes(""),
+          "base64 accepts canonical padded and unpadded groups");
+    check(!base64Decodes("QR==") && !base64Decodes("QUJ=") && !base64Decodes("QR") && !base64Decodes("QUJ"),
+          "base64 rejects non-zero trailing bits");
+    check(!base64Decodes("Q") && !base64Decodes("Q===") && !base64Decodes("QUJD=") &&
+          !base64Decodes("=QQ=") && !base64Decodes("QQ=A"),
+          "base64 rejects impossible lengths and misplaced padding");
+    
+    std::string long_hex(64, 'a');
+    check(hexDecodes("") && hexDecodes("aB") && hexDecodes(long_hex), "hex accepts even lengths");
+    check(!hexDecodes("a") && !hexDecodes("abc") && !hexDecodes(long_hex + "a") &&
+          Encoding::fromHex(long_hex + "a").empty(), "hex rejects odd lengths");
+}
+
+} // namespace
+
+int main() {
+    std::mt19937 rng(42);
+    
+    testRoundTrips(rng);
+    testSubstitutions(rng);
+    testRules();
+    
+    std::cout << (failures == 0 ? "All encoding tests passed" : "Encoding tests failed: " + std::to_string(failures))
+              << std::endl;
+    return failures == 0 ? 0 : 1;
+}
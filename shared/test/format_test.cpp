@@ -0,0 +1,230 @@
+// Capsule format round-trip test.
+// Round-trips the block container (TCHF), chunked GCM capsules (TCGM) and
+// seekable capsules (TCSK), then flips single header, index, tag and data
+// bytes and checks that every reader rejects them. Scratch files are
+// written to the current directory and removed afterwards.
+//
+//   make test             (from sender/)
+//   ./format_test
+
+#include "aes_cbc.h"
+#include "codec.h"
+#include "seekable.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* kPlainFile = "format_test.plain";
+const char* kCapsuleFile = "format_test.capsule";
+const char* kOutputFile = "format_test.out";
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    std::cout << (ok ? "PASS  " : "FAIL  ") << what << std::endl;
+    if (!ok) {
+        failures++;
+    }
+}
+
+// Text with random runs, so every codec has both matches and literals
+std::vector<uint8_t> makeInput(size_t size) {
+    static const char* words[] = {"time", "capsule", "release", "sender", "receiver", "key"};
+    std::mt19937 rng(42);
+    std::vector<uint8_t> data;
+    data.reserve(size);
+    while (data.size() < size) {
+        if (rng() % 8 == 0) {
+            for (int i = 0; i < 64; i++) {
+                data.push_back(static_cast<uint8_t>(rng()));
+            }
+            continue;
+        }
+        const char* word = words[rng() % (sizeof(words) / sizeof(words[0]))];
+        data.insert(data.end(), word, word + std::char_traits<char>::length(word));
+        data.push_back(' ');
+    }
+    data.resize(size);
+    return data;
+}
+
+bool writeFile(const std::string& path, const std::vector<uint8_t>& data) {
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    file.close();
+    return !file.fail();
+}
+
+std::vector<uint8_t> readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+bool fileExists(const std::string& path) {
+    return std::ifstream(path).good();
+}
+
+std::vector<uint8_t> flipped(std::vector<uint8_t> data, size_t pos) {
+    data[pos] ^= 0x01;
+    return data;
+}
+
+uint64_t getU64(const uint8_t* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+bool streamDecompress(const std::vector<uint8_t>& container, std::vector<uint8_t>& output) {
+    output.clear();
+    auto decoder = createStreamDecompressor([&output](std::vector<uint8_t>&& piece) {
+        output.insert(output.end(), piece.begin(), piece.end());
+        return true;
+    }, 2);
+    // Odd-sized pieces, so frames straddle updates
+    const size_t piece = 100003;
+    for (size_t pos = 0; pos < container.size(); pos += piece) {
+        size_t size = std::min(piece, container.size() - pos);
+        if (!decoder->update(container.data() + pos, size)) {
+            return false;
+        }
+    }
+    return decoder->finish();
+}
+
+// True when decompressData, decompressFile and the stream decoder all refuse `container`
+bool containerRejected(CompressionCodec& codec, const std::vector<uint8_t>& container) {
+    std::vector<uint8_t> output;
+    if (codec.decompressData(container, output) || streamDecompress(container, output)) {
+        return false;
+    }
+    return writeFile(kCapsuleFile, container) && !codec.decompressFile(kCapsuleFile, kOutputFile);
+}
+
+void testContainer(const std::vector<uint8_t>& input) {
+    for (int level : {0, 3, 6}) {
+        std::unique_ptr<CompressionCodec> codec = createCodecForLevel(level);
+        std::string name = "TCHF level " + std::to_string(level);
+        
+        std::vector<uint8_t> container;
+        std::vector<uint8_t> output;
+        check(codec->compressData(input, container) && codec->decompressData(container, output) &&
+              output == input, name + " round trip");
+        check(streamDecompress(container, output) && output == input, name + " stream round trip");
+        check(writeFile(kCapsuleFile, container) && codec->decompressFile(kCapsuleFile, kOutputFile) &&
+              readFile(kOutputFile) == input, name + " file round trip");
+        
+        // Footer: block_count(4) | index_offset(8) | "TCHI"
+        size_t index_offset = getU64(container.data() + container.size() - 12);
+        check(containerRejected(*codec, flipped(container, 12)), name + " rejects header byte");
+        check(containerRejected(*codec, flipped(container, 20 + 8)), name + " rejects frame CRC byte");
+        check(containerRejected(*codec, flipped(container, index_offset)), name + " rejects index offset byte");
+        check(containerRejected(*codec, flipped(container, index_offset + 8)), name + " rejects index size byte");
+        check(containerRejected(*codec, flipped(container, container.size() - 12)),
+              name + " rejects footer byte");
+    }
+}
+
+bool gcmRejected(AESCrypto& aes, const std::vector<uint8_t>& capsule, const std::vector<uint8_t>& key) {
+    std::remove(kOutputFile);
+    return writeFile(kCapsuleFile, capsule) && !aes.decryptFileGCM(kCapsuleFile, kOutputFile, key, 2) &&
+           !fileExists(kOutputFile);
+}
+
+void testGcm(const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
+    AESCrypto aes;
+    check(aes.encryptFileGCM(kPlainFile, kCapsuleFile, key, iv, 2) &&
+          aes.decryptFileGCM(kCapsuleFile, kOutputFile, key, 2) &&
+          readFile(kOutputFile) == readFile(kPlainFile), "TCGM round trip");
+    
+    std::vector<uint8_t> capsule = readFile(kCapsuleFile);
+    std::vector<uint8_t> output;
+    std::vector<uint8_t> piece;
+    std::unique_ptr<CapsuleDecryptor> decryptor = AESCrypto::createDecryptor(key, iv, 2);
+    bool ok = decryptor != nullptr;
+    for (size_t pos = 0; ok && pos < capsule.size(); pos += 100003) {
+        piece.clear();
+        ok = decryptor->update(capsule.data() + pos, std::min<size_t>(100003, capsule.size() - pos), piece);
+        output.insert(output.end(), piece.begin(), piece.end());
+    }
+    piece.clear();
+    ok = ok && decryptor->finish(piece);
+    output.insert(output.end(), piece.begin(), piece.end());
+    check(ok && output == readFile(kPlainFile), "TCGM stream round trip");
+    
+    // Header: "TCGM" | version(1) | reserved(3) | chunk_size(4) | nonce_prefix(8)
+    check(gcmRejected(aes, flipped(capsule, 12), key), "TCGM rejects header byte");
+    check(gcmRejected(aes, flipped(capsule, 20 + 100), key), "TCGM rejects ciphertext byte");
+    check(gcmRejected(aes, flipped(capsule, capsule.size() - 1), key), "TCGM rejects tag byte");
+}
+
+bool seekableRejected(const std::vector<uint8_t>& capsule, const std::vector<uint8_t>& key) {
+    std::remove(kOutputFile);
+    return writeFile(kCapsuleFile, capsule) &&
+           !SeekableCapsule::decryptFile(kCapsuleFile, kOutputFile, key, 2) && !fileExists(kOutputFile);
+}
+
+void testSeekable(const std::vector<uint8_t>& input, const std::vector<uint8_t>& key,
+                  const std::vector<uint8_t>& iv) {
+    check(SeekableCapsule::encryptFile(kPlainFile, kCapsuleFile, key, iv, 6, 2) &&
+          SeekableCapsule::decryptFile(kCapsuleFile, kOutputFile, key, 2) &&
+          readFile(kOutputFile) == input, "TCSK round trip");
+    
+    const uint64_t offset = SeekableCapsule::kDefaultChunkSize - 1000;
+    const uint64_t length = 5000;
+    check(SeekableCapsule::decryptRange(SeekableCapsule::fileReader(kCapsuleFile), key, offset, length,
+                                        kOutputFile, 2) &&
+          readFile(kOutputFile) == std::vector<uint8_t>(input.begin() + offset, input.begin() + offset + length),
+          "TCSK range round trip");
+    
+    // Index entry: offset(8) | stored_size(4) | plain_size(4) | tag(16)
+    std::vector<uint8_t> capsule = readFile(kCapsuleFile);
+    const size_t index = SeekableCapsule::kHeaderSize;
+    check(seekableRejected(flipped(capsule, 16), key), "TCSK rejects header byte");
+    check(seekableRejected(flipped(capsule, index + 8), key), "TCSK rejects index size byte");
+    check(seekableRejected(flipped(capsule, index + 16), key), "TCSK rejects index tag byte");
+    check(seekableRejected(flipped(capsule, capsule.size() - 1), key), "TCSK rejects chunk byte");
+}
+
+} // namespace
+
+int main() {
+    // Several blocks and chunks, the last one partial
+    std::vector<uint8_t> input = makeInput(2 * SeekableCapsule::kDefaultChunkSize + 12345);
+    std::vector<uint8_t> key(32);
+    std::vector<uint8_t> iv(16);
+    for (size_t i = 0; i < key.size(); i++) {
+        key[i] = static_cast<uint8_t>(i * 7 + 1);
+    }
+    for (size_t i = 0; i < iv.size(); i++) {
+        iv[i] = static_cast<uint8_t>(i * 13 + 5);
+    }
+    
+    if (!writeFile(kPlainFile, input)) {
+        std::cerr << "Cannot write " << kPlainFile << std::endl;
+        return 1;
+    }
+    
+    testContainer(input);
+    testGcm(key, iv);
+    testSeekable(input, key, iv);
+    
+    std::remove(kPlainFile);
+    std::remove(kCapsuleFile);
+    std::remove(kOutputFile);
+    
+    std::cout << (failures == 0 ? "All format tests passed" : "Format tests failed: " + std::to_string(failures))
+              << std::endl;
+    return failures == 0 ? 0 : 1;
+}
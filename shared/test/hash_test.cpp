@@ -0,0 +1,143 @@
+// Multi-buffer SHA-256 test.
+// Compares MultiBufferSHA256::hash and HashUtils::computeSHA256Batch with
+// Crypto++'s SHA256 for every lane count, at the padding boundaries and
+// random sizes, with short and long messages mixed in one call so lanes
+// that finish early have to be masked. Reports whether the AVX2 lanes ran.
+//
+//   make test             (from sender/)
+//   ./hash_test
+
+#include "hash_utils.h"
+#include "sha256_multi.h"
+
+#include <cryptopp/sha.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    std::cout << (ok ? "PASS  " : "FAIL  ") << what << std::endl;
+    if (!ok) {
+        failures++;
+    }
+}
+
+std::vector<uint8_t> referenceDigest(const std::vector<uint8_t>& message) {
+    std::vector<uint8_t> digest(CryptoPP::SHA256::DIGESTSIZE);
+    CryptoPP::SHA256().CalculateDigest(digest.data(), message.data(), message.size());
+    return digest;
+}
+
+std::vector<uint8_t> randomMessage(size_t size, std::mt19937& rng) {
+    std::vector<uint8_t> message(size);
+    for (uint8_t& byte : message) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    return message;
+}
+
+// Hashes `messages` in one call and counts lanes that differ from Crypto++
+size_t laneMismatches(const std::vector<std::vector<uint8_t>>& messages) {
+    const uint8_t* data[MultiBufferSHA256::kLanes];
+    size_t sizes[MultiBufferSHA256::kLanes];
+    for (size_t lane = 0; lane < messages.size(); lane++) {
+        data[lane] = messages[lane].data();
+        sizes[lane] = messages[lane].size();
+    }
+    std::vector<uint8_t> digests(messages.size() * MultiBufferSHA256::kDigestSize);
+    MultiBufferSHA256::hash(data, sizes, messages.size(), digests.data());
+    
+    size_t mismatches = 0;
+    for (size_t lane = 0; lane < messages.size(); lane++) {
+        std::vector<uint8_t> expected = referenceDigest(messages[lane]);
+        if (!std::equal(expected.begin(), expected.end(),
+                        digests.begin() + lane * MultiBufferSHA256::kDigestSize)) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+void testLanes(std::mt19937& rng) {
+    // Empty, one block with room for the length, padding spilling into a
+    // second block, exact block multiples and their neighbours
+    static const size_t boundaries[] = {0, 55, 56, 63, 64, 65, 119, 120};
+    
+    for (size_t count = 1; count <= MultiBufferSHA256::kLanes; count++) {
+        std::string name = std::to_string(count) + " lane" + (count > 1 ? "s" : "");
+        size_t mismatches = 0;
+        
+        // Every boundary size in every lane, all lanes the same length
+        for (size_t size : boundaries) {
+            mismatches += laneMismatches(std::vector<std::vector<uint8_t>>(count, randomMessage(size, rng)));
+        }
+        // Boundary sizes rotated across lanes, so lengths differ by a block or less
+        for (size_t shift = 0; shift < sizeof(boundaries) / sizeof(boundaries[0]); shift++) {
+            std::vector<std::vector<uint8_t>> messages;
+            for (size_t lane = 0; lane < count; lane++) {
+                size_t size = boundaries[(lane + shift) % (sizeof(boundaries) / sizeof(boundaries[0]))];
+                messages.push_back(randomMessage(size, rng));
+            }
+            mismatches += laneMismatches(messages);
+        }
+        check(mismatches == 0, name + " at padding boundaries");
+        
+        // Random sizes, with one long lane among short ones so most lanes
+        // sit idle for many blocks
+        mismatches = 0;
+        for (int round = 0; round < 200; round++) {
+            std::vector<std::vector<uint8_t>> messages;
+            for (size_t lane = 0; lane < count; lane++) {
+                size_t size = lane == round % count ? 1000 + rng() % 4000 : rng() % 200;
+                messages.push_back(randomMessage(size, rng));
+            }
+            mismatches += laneMismatches(messages);
+        }
+        check(mismatches == 0, name + " with mixed short and long messages");
+    }
+}
+
+void testBatch(std::mt19937& rng) {
+    std::vector<std::vector<uint8_t>> inputs;
+    for (size_t size : {0, 55, 56, 63, 64, 65, 119, 120}) {
+        inputs.push_back(randomMessage(size, rng));
+    }
+    for (int i = 0; i < 300; i++) {
+        inputs.push_back(randomMessage(i % 10 == 0 ? 4096 + rng() % 60000 : rng() % 600, rng));
+    }
+    
+    HashUtils hash_utils;
+    for (size_t threads : {1, 4}) {
+        std::vector<std::string> digests = HashUtils::computeSHA256Batch(inputs, threads);
+        size_t mismatches = digests.size() == inputs.size() ? 0 : inputs.size();
+        for (size_t i = 0; i < digests.size() && i < inputs.size(); i++) {
+            if (digests[i] != hash_utils.computeSHA256(inputs[i])) {
+                mismatches++;
+            }
+        }
+        check(mismatches == 0, "computeSHA256Batch on " + std::to_string(threads) + " thread" +
+              (threads > 1 ? "s" : ""));
+    }
+}
+
+} // namespace
+
+int main() {
+    std::mt19937 rng(42);
+    std::cout << "Multi-buffer lanes " << (MultiBufferSHA256::accelerated() ? "enabled (AVX2)" : "disabled")
+              << std::endl;
+    
+    testLanes(rng);
+    testBatch(rng);
+    
+    std::cout << (failures == 0 ? "All hash tests passed" : "Hash tests failed: " + std::to_string(failures))
+              << std::endl;
+    return failures == 0 ? 0 : 1;
+}